@@ -0,0 +1,284 @@
+// bench.cpp -- Google Benchmark microbenchmarks for the homomorphic primitives of the pipeline
+//
+// Every primitive the search circuit is built from (encode, encrypt, EvalMult,
+// EvalSum, single and hoisted rotations, the max polynomial, the threshold compare
+// and decrypt) is timed on a CKKS context for each ring dimension in RING_LOG2 and
+// each multiplicative depth in DEPTHS. Benchmarks are registered context by context,
+// so only one context and its keys are alive at a time; context and key generation
+// happen outside the timed loops.
+//
+// Ring dimensions are forced with HEStd_NotSet: small rings at large depths are below
+// 128-bit security, which is fine for timing but not for deployment (the demo lets the
+// planner pick the ring).
+//
+// The plaintext kernels (kernels.h: batch normalization and the baseline scan) are
+// timed separately, once per SIMD level the CPU supports and per precision, over a
+// gallery far larger than the caches; their bytes_per_second is the figure to hold
+// against the machine's memory bandwidth.
+//
+// Results go to bench.json (Google Benchmark JSON) unless --benchmark_out is given;
+// all other --benchmark_* flags work as usual, e.g.
+//     ./bench --benchmark_filter='EvalMult/ring:1[34]/'
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "openfhe/pke/openfhe.h"
+#include "compare.h"
+#include "kernels.h"
+#include "matrix.h"
+#include "rotation.h"
+
+using namespace lbcrypto;
+
+static const uint32_t RING_LOG2[] = {13, 14, 15, 16, 17};
+static const uint32_t DEPTHS[] = {5, 10, 20};
+static const uint32_t SCALE_BITS = 40;
+static const uint32_t FIRST_MOD_BITS = 60;
+static const double MAX_PRECISION = 1e-4;  // as in the demo; picks the deepest preset that fits
+static const size_t HOISTED_ROTATIONS = 8;  // rotations by 1, 2, 4, ... sharing one decomposition
+static const size_t SCAN_ROWS = 100000;     // baseline scan gallery: 200 MB as float, 400 MB as double
+static const size_t SCAN_DIM = 512;
+static const size_t SCAN_PROBES = 4;
+
+struct BenchContext {
+    uint32_t ring_log2 = 0;
+    uint32_t depth = 0;
+    CryptoContext<DCRTPoly> cc;
+    KeyPair<DCRTPoly> kp;
+    uint32_t slots = 0;
+    bool sum_keys = false;  // EvalSum keys are only generated when an EvalSum benchmark runs
+};
+
+// The context of the benchmark being run; replaced when the next configuration starts.
+static std::unique_ptr<BenchContext> current;
+
+static std::vector<int32_t> hoisted_indices() {
+    std::vector<int32_t> idx;
+    for (size_t i = 0; i < HOISTED_ROTATIONS; i++) idx.push_back(1 << i);
+    return idx;
+}
+
+static BenchContext &context_for(uint32_t ring_log2, uint32_t depth) {
+    if (current && current->ring_log2 == ring_log2 && current->depth == depth) return *current;
+    current.reset();
+    CryptoContextImpl<DCRTPoly>::ClearEvalMultKeys();
+    CryptoContextImpl<DCRTPoly>::ClearEvalAutomorphismKeys();
+    CryptoContextImpl<DCRTPoly>::ClearEvalSumKeys();
+
+    std::unique_ptr<BenchContext> bc(new BenchContext);
+    bc->ring_log2 = ring_log2;
+    bc->depth = depth;
+    bc->slots = (1u << ring_log2) / 2;
+    CCParams<CryptoContextCKKSRNS> p;
+    p.SetMultiplicativeDepth(depth);
+    p.SetScalingModSize(SCALE_BITS);
+    p.SetFirstModSize(FIRST_MOD_BITS);
+    p.SetRingDim(1u << ring_log2);
+    p.SetBatchSize(bc->slots);
+    p.SetSecurityLevel(HEStd_NotSet);
+    bc->cc = GenCryptoContext(p);
+    bc->cc->Enable(PKE);
+    bc->cc->Enable(KEYSWITCH);
+    bc->cc->Enable(LEVELEDSHE);
+    bc->cc->Enable(ADVANCEDSHE);
+    bc->kp = bc->cc->KeyGen();
+    bc->cc->EvalMultKeyGen(bc->kp.secretKey);
+    bc->cc->EvalRotateKeyGen(bc->kp.secretKey, hoisted_indices());
+    current = std::move(bc);
+    return *current;
+}
+
+// Uniform values in [-1, 1], the domain of every score the pipeline compares.
+static std::vector<double> random_slots(uint32_t slots, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::vector<double> v(slots);
+    for (auto &x : v) x = dist(rng);
+    return v;
+}
+
+static Ciphertext<DCRTPoly> random_ct(const BenchContext &bc, uint32_t seed) {
+    return bc.cc->Encrypt(bc.kp.publicKey, bc.cc->MakeCKKSPackedPlaintext(random_slots(bc.slots, seed)));
+}
+
+static void annotate(benchmark::State &state, const BenchContext &bc) {
+    state.counters["ring_dim"] = static_cast<double>(bc.cc->GetRingDimension());
+    state.counters["depth"] = bc.depth;
+    state.counters["slots"] = bc.slots;
+}
+
+static void bm_encode(benchmark::State &state, uint32_t ring_log2, uint32_t depth) {
+    BenchContext &bc = context_for(ring_log2, depth);
+    std::vector<double> v = random_slots(bc.slots, 1);
+    for (auto _ : state) benchmark::DoNotOptimize(bc.cc->MakeCKKSPackedPlaintext(v));
+    annotate(state, bc);
+}
+
+static void bm_encrypt(benchmark::State &state, uint32_t ring_log2, uint32_t depth) {
+    BenchContext &bc = context_for(ring_log2, depth);
+    Plaintext pt = bc.cc->MakeCKKSPackedPlaintext(random_slots(bc.slots, 1));
+    for (auto _ : state) benchmark::DoNotOptimize(bc.cc->Encrypt(bc.kp.publicKey, pt));
+    annotate(state, bc);
+}
+
+static void bm_eval_mult(benchmark::State &state, uint32_t ring_log2, uint32_t depth) {
+    BenchContext &bc = context_for(ring_log2, depth);
+    Ciphertext<DCRTPoly> a = random_ct(bc, 1), b = random_ct(bc, 2);
+    for (auto _ : state) benchmark::DoNotOptimize(bc.cc->EvalMult(a, b));
+    annotate(state, bc);
+}
+
+static void bm_eval_sum(benchmark::State &state, uint32_t ring_log2, uint32_t depth) {
+    BenchContext &bc = context_for(ring_log2, depth);
+    if (!bc.sum_keys) {
+        bc.cc->EvalSumKeyGen(bc.kp.secretKey);
+        bc.sum_keys = true;
+    }
+    Ciphertext<DCRTPoly> a = random_ct(bc, 1);
+    for (auto _ : state) benchmark::DoNotOptimize(bc.cc->EvalSum(a, bc.slots));
+    annotate(state, bc);
+}
+
+static void bm_rotate(benchmark::State &state, uint32_t ring_log2, uint32_t depth) {
+    BenchContext &bc = context_for(ring_log2, depth);
+    Ciphertext<DCRTPoly> a = random_ct(bc, 1);
+    for (auto _ : state) benchmark::DoNotOptimize(bc.cc->EvalRotate(a, 1));
+    annotate(state, bc);
+}
+
+static void bm_hoisted_rotations(benchmark::State &state, uint32_t ring_log2, uint32_t depth) {
+    BenchContext &bc = context_for(ring_log2, depth);
+    Ciphertext<DCRTPoly> a = random_ct(bc, 1);
+    const std::vector<int32_t> idx = hoisted_indices();
+    for (auto _ : state) benchmark::DoNotOptimize(hoisted_rotations(bc.cc, a, idx));
+    annotate(state, bc);
+    state.counters["rotations"] = static_cast<double>(idx.size());
+}
+
+static void bm_max_poly(benchmark::State &state, uint32_t ring_log2, uint32_t depth) {
+    BenchContext &bc = context_for(ring_log2, depth);
+    const SignPreset preset = sign_preset_for(MAX_PRECISION, depth);
+    Ciphertext<DCRTPoly> a = random_ct(bc, 1), b = random_ct(bc, 2);
+    for (auto _ : state) benchmark::DoNotOptimize(eval_max(bc.cc, a, b, preset.approx));
+    annotate(state, bc);
+    state.counters["poly_depth"] = preset.approx.max_depth();
+}
+
+static void bm_compare(benchmark::State &state, uint32_t ring_log2, uint32_t depth) {
+    BenchContext &bc = context_for(ring_log2, depth);
+    // eval_less_than uses approx.depth() = max_depth() - 1 levels
+    const SignPreset preset = sign_preset_for(MAX_PRECISION, depth + 1);
+    Ciphertext<DCRTPoly> a = random_ct(bc, 1);
+    for (auto _ : state) benchmark::DoNotOptimize(eval_less_than(bc.cc, a, 0.5, preset.approx));
+    annotate(state, bc);
+    state.counters["poly_depth"] = preset.approx.depth();
+}
+
+static void bm_decrypt(benchmark::State &state, uint32_t ring_log2, uint32_t depth) {
+    BenchContext &bc = context_for(ring_log2, depth);
+    Ciphertext<DCRTPoly> a = random_ct(bc, 1);
+    for (auto _ : state) {
+        Plaintext pt;
+        bc.cc->Decrypt(bc.kp.secretKey, a, &pt);
+        benchmark::DoNotOptimize(pt);
+    }
+    annotate(state, bc);
+}
+
+template <class T>
+static Matrix<T> random_rows(size_t rows, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<T> d(0, 1);
+    Matrix<T> m(rows, SCAN_DIM);
+    for (size_t i = 0; i < rows; i++)
+        for (size_t k = 0; k < SCAN_DIM; k++) m(i, k) = d(rng);
+    return m;
+}
+
+template <class T>
+static void bm_normalize(benchmark::State &state, SimdLevel level) {
+    Matrix<T> db = random_rows<T>(SCAN_ROWS, 7);
+    // rescales already-unit rows after the first pass: same work, same memory traffic
+    for (auto _ : state) benchmark::DoNotOptimize(normalize_rows(db, SCAN_ROWS, level));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * SCAN_ROWS * db.ld() * sizeof(T)));
+}
+
+template <class T>
+static void bm_baseline_scan(benchmark::State &state, SimdLevel level) {
+    Matrix<T> db = random_rows<T>(SCAN_ROWS, 7), probes = random_rows<T>(SCAN_PROBES, 8);
+    normalize_rows(db);
+    normalize_rows(probes);
+    const RowView<T> rows = row_block(db, 0, 0, SCAN_ROWS);
+    for (auto _ : state) {
+        std::vector<BestMatch> best(SCAN_PROBES);
+        scan_similarities(rows, probes, best, nullptr, 0, level);
+        benchmark::DoNotOptimize(best.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * SCAN_ROWS * db.ld() * sizeof(T)));
+    state.counters["probes"] = SCAN_PROBES;
+}
+
+int main(int argc, char **argv) {
+    static const struct {
+        const char *name;
+        void (*fn)(benchmark::State &, uint32_t, uint32_t);
+    } PRIMITIVES[] = {
+        {"Encode", bm_encode},
+        {"Encrypt", bm_encrypt},
+        {"EvalMult", bm_eval_mult},
+        {"EvalSum", bm_eval_sum},
+        {"Rotate", bm_rotate},
+        {"HoistedRotations", bm_hoisted_rotations},
+        {"MaxPoly", bm_max_poly},
+        {"Compare", bm_compare},
+        {"Decrypt", bm_decrypt},
+    };
+    // grouped by context so each one is generated once
+    for (uint32_t ring_log2 : RING_LOG2) {
+        for (uint32_t depth : DEPTHS) {
+            for (const auto &prim : PRIMITIVES) {
+                const std::string name = std::string(prim.name) + "/ring:" + std::to_string(ring_log2) +
+                                         "/depth:" + std::to_string(depth);
+                // OpenFHE runs its own OpenMP threads, so main-thread CPU time would undercount
+                benchmark::RegisterBenchmark(name.c_str(), prim.fn, ring_log2, depth)
+                    ->Unit(benchmark::kMillisecond)
+                    ->UseRealTime();
+            }
+        }
+    }
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512}) {
+        if (level > simd_level()) break;
+        const std::string suffix = std::string("/") + simd_level_name(level);
+        benchmark::RegisterBenchmark(("Normalize/float" + suffix).c_str(), bm_normalize<float>, level)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("Normalize/double" + suffix).c_str(), bm_normalize<double>, level)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("BaselineScan/float" + suffix).c_str(), bm_baseline_scan<float>, level)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("BaselineScan/double" + suffix).c_str(), bm_baseline_scan<double>, level)
+            ->Unit(benchmark::kMillisecond);
+    }
+
+    // JSON to bench.json by default, so release runs can be diffed for regressions
+    std::vector<char *> args(argv, argv + argc);
+    bool has_out = false;
+    for (int i = 1; i < argc; i++) has_out |= std::string(argv[i]).rfind("--benchmark_out=", 0) == 0;
+    std::string out_flag = "--benchmark_out=bench.json", format_flag = "--benchmark_out_format=json";
+    if (!has_out) {
+        args.push_back(&out_flag[0]);
+        args.push_back(&format_flag[0]);
+    }
+    int n = static_cast<int>(args.size());
+    benchmark::Initialize(&n, args.data());
+    if (benchmark::ReportUnrecognizedArguments(n, args.data())) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    current.reset();
+    return 0;
+}
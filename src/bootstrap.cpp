@@ -0,0 +1,42 @@
+// bootstrap.cpp -- CKKS bootstrapping and level management (see bootstrap.h)
+
+#include "bootstrap.h"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace lbcrypto;
+
+uint32_t bootstrap_depth(const BootstrapConfig &cfg, SecretKeyDist dist) {
+    return FHECKKSRNS::GetBootstrapDepth(cfg.level_budget, dist);
+}
+
+uint32_t bootstrap_context_depth(const BootstrapConfig &cfg, SecretKeyDist dist) {
+    return cfg.levels_after + bootstrap_depth(cfg, dist);
+}
+
+void setup_bootstrapping(const CryptoContext<DCRTPoly> &cc, const BootstrapConfig &cfg, uint32_t slots) {
+    cc->EvalBootstrapSetup(cfg.level_budget, {0, 0}, slots);
+}
+
+LevelRefresher::LevelRefresher(CryptoContext<DCRTPoly> cc, uint32_t total_depth, bool bootstrap_enabled)
+    : cc_(std::move(cc)), total_depth_(total_depth), enabled_(bootstrap_enabled) {}
+
+uint32_t LevelRefresher::remaining(const Ciphertext<DCRTPoly> &ct) const {
+    size_t used = ct->GetLevel() + (ct->GetNoiseScaleDeg() - 1);
+    return used >= total_depth_ ? 0 : static_cast<uint32_t>(total_depth_ - used);
+}
+
+Ciphertext<DCRTPoly> LevelRefresher::ensure(const Ciphertext<DCRTPoly> &ct, uint32_t needed) {
+    if (remaining(ct) >= needed) return ct;
+    if (!enabled_)
+        throw std::runtime_error("out of levels: need " + std::to_string(needed) + ", have " +
+                                 std::to_string(remaining(ct)) + " and bootstrapping is disabled");
+    Ciphertext<DCRTPoly> fresh = cc_->EvalBootstrap(ct);
+    bootstraps_++;
+    if (remaining(fresh) < needed)
+        throw std::runtime_error("bootstrapping leaves " + std::to_string(remaining(fresh)) +
+                                 " levels, next step needs " + std::to_string(needed));
+    return fresh;
+}
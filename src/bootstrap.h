@@ -0,0 +1,57 @@
+// bootstrap.h -- CKKS bootstrapping and level management for deep reductions
+//
+// A polynomial max costs several levels per tournament round, so a reduction over
+// thousands of scores does not fit in any practical modulus chain. With bootstrapping
+// enabled the chain only has to hold one stretch of rounds: LevelRefresher checks the
+// remaining levels of a ciphertext before each step and calls EvalBootstrap when the
+// next step would not fit.
+//
+// Only whole score ciphertexts are ever refreshed (never per-score values), so one
+// bootstrap refreshes every similarity packed into that ciphertext.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "openfhe/pke/openfhe.h"
+
+struct BootstrapConfig {
+    std::vector<uint32_t> level_budget = {3, 3};  // CoeffsToSlots / SlotsToCoeffs levels
+    uint32_t levels_after = 0;                    // levels left for the circuit after a refresh
+};
+
+// Levels consumed by EvalBootstrap itself for this configuration.
+uint32_t bootstrap_depth(const BootstrapConfig &cfg, lbcrypto::SecretKeyDist dist);
+
+// Multiplicative depth the context needs: levels_after + bootstrap_depth.
+uint32_t bootstrap_context_depth(const BootstrapConfig &cfg, lbcrypto::SecretKeyDist dist);
+
+// EvalBootstrapSetup for `slots` slots. Call after Enable(FHE) and before key generation.
+void setup_bootstrapping(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc, const BootstrapConfig &cfg,
+                         uint32_t slots);
+
+class LevelRefresher {
+public:
+    // total_depth: multiplicative depth of the context. With bootstrapping disabled,
+    // ensure() throws instead of refreshing.
+    LevelRefresher(lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc, uint32_t total_depth, bool bootstrap_enabled);
+
+    // Levels the ciphertext can still consume (pending rescales count as consumed).
+    uint32_t remaining(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &ct) const;
+
+    // Returns ct if it has at least `needed` levels left, otherwise a bootstrapped copy.
+    // Throws std::runtime_error if bootstrapping is disabled or cannot provide `needed`.
+    lbcrypto::Ciphertext<lbcrypto::DCRTPoly> ensure(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &ct,
+                                                    uint32_t needed);
+
+    size_t bootstraps() const { return bootstraps_.load(); }
+
+private:
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc_;
+    uint32_t total_depth_;
+    bool enabled_;
+    std::atomic<size_t> bootstraps_{0};
+};
@@ -0,0 +1,164 @@
+// compare.cpp -- composite polynomial sign / max (see compare.h)
+
+#include "compare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+using namespace lbcrypto;
+
+// Odd coefficients c_i of x^(2i+1).
+// f_n(x) = sum_{i=0}^{n} 4^-i C(2i, i) x (1 - x^2)^i
+static const std::vector<double> F_COEFFS[] = {
+    {},
+    {3.0 / 2, -1.0 / 2},
+    {15.0 / 8, -10.0 / 8, 3.0 / 8},
+    {35.0 / 16, -35.0 / 16, 21.0 / 16, -5.0 / 16},
+};
+// g_m from Cheon et al., Table 2 (coefficients / 2^10)
+static const std::vector<double> G_COEFFS[] = {
+    {},
+    {2126.0 / 1024, -1359.0 / 1024},
+    {3334.0 / 1024, -6108.0 / 1024, 3796.0 / 1024},
+    {4589.0 / 1024, -16577.0 / 1024, 25614.0 / 1024, -12860.0 / 1024},
+};
+
+static uint32_t odd_poly_depth(uint32_t n) {
+    // degree 2n+1 -> ceil(log2(2n+2))
+    uint32_t d = 0;
+    while ((1u << d) < 2 * n + 2) d++;
+    return d;
+}
+
+uint32_t SignApprox::depth() const {
+    return g_iters * odd_poly_depth(g_n) + f_iters * odd_poly_depth(f_n);
+}
+
+uint32_t SignApprox::max_depth() const { return depth() + 1; }
+
+// Ordered by depth; each entry is the most precise composition at its depth.
+static const SignPreset PRESETS[] = {
+    {{1, 0, 1, 1}, 1.74e-1},
+    {{1, 0, 3, 1}, 1.22e-1},
+    {{1, 1, 1, 1}, 8.66e-2},
+    {{1, 1, 3, 1}, 5.93e-2},
+    {{3, 1, 3, 1}, 2.75e-2},
+    {{3, 1, 1, 2}, 2.68e-2},
+    {{3, 2, 3, 1}, 1.02e-2},
+    {{3, 2, 1, 2}, 8.78e-3},
+    {{3, 2, 3, 2}, 2.83e-3},
+    {{3, 3, 3, 2}, 6.30e-4},
+    {{3, 4, 3, 2}, 1.40e-4},
+    {{3, 4, 3, 3}, 6.42e-5},
+};
+
+SignPreset sign_preset_for(double target_error, uint32_t depth_budget) {
+    const SignPreset *best = nullptr;
+    for (const SignPreset &p : PRESETS) {
+        if (p.approx.max_depth() > depth_budget) break;
+        best = &p;
+        if (p.max_error <= target_error) break;
+    }
+    if (!best) throw std::invalid_argument("sign_preset_for: depth budget below shallowest max polynomial");
+    return *best;
+}
+
+// Plain (double) evaluation of the composite polynomial, for planning only.
+static double odd_poly_plain(const std::vector<double> &c, double x) {
+    double acc = 0, p = x;
+    for (double ci : c) {
+        acc += ci * p;
+        p *= x * x;
+    }
+    return acc;
+}
+
+static double sign_plain(const SignApprox &approx, double x) {
+    for (uint32_t i = 0; i < approx.g_iters; i++) x = odd_poly_plain(G_COEFFS[approx.g_n], x);
+    for (uint32_t i = 0; i < approx.f_iters; i++) x = odd_poly_plain(F_COEFFS[approx.f_n], x);
+    return x;
+}
+
+// The step evaluates sign((x - tau) / 2), an odd polynomial, so the worst case over
+// |x - tau| in [margin, 2] is the worst |1 - sign| over [margin / 2, 1], halved.
+static double step_error(const SignApprox &approx, double margin) {
+    const int GRID = 4096;
+    const double lo = std::clamp(margin / 2, 0.0, 1.0);
+    double worst = 0;
+    for (int i = 0; i <= GRID; i++)
+        worst = std::max(worst, std::abs(1 - sign_plain(approx, lo + (1 - lo) * i / GRID)) / 2);
+    return worst;
+}
+
+StepPreset step_preset_for(double margin, size_t bits) {
+    if (!(margin > 0)) throw std::invalid_argument("step_preset_for: margin must be positive");
+    StepPreset best{};
+    for (const SignPreset &p : PRESETS) {
+        best = {p.approx, step_error(p.approx, margin)};
+        if (best.step_error * static_cast<double>(bits) <= STEP_ERROR_BUDGET) break;
+    }
+    return best;
+}
+
+// sum_i c_i x^(2i+1) for up to four coefficients at depth ceil(log2(2n+2)).
+// Each coefficient is multiplied into x first so it rides along a product that
+// happens anyway instead of costing its own level.
+static Ciphertext<DCRTPoly> eval_odd_poly(const CryptoContext<DCRTPoly> &cc, const Ciphertext<DCRTPoly> &x,
+                                          const std::vector<double> &c) {
+    Ciphertext<DCRTPoly> x2 = cc->EvalSquare(x);
+    Ciphertext<DCRTPoly> x4 = c.size() > 2 ? cc->EvalSquare(x2) : nullptr;
+    Ciphertext<DCRTPoly> acc = cc->EvalMult(x, c[0]);
+    if (c.size() > 1) cc->EvalAddInPlace(acc, cc->EvalMult(cc->EvalMult(x, c[1]), x2));
+    if (c.size() > 2) cc->EvalAddInPlace(acc, cc->EvalMult(cc->EvalMult(x, c[2]), x4));
+    if (c.size() > 3) cc->EvalAddInPlace(acc, cc->EvalMult(cc->EvalMult(cc->EvalMult(x, c[3]), x2), x4));
+    return acc;
+}
+
+static std::vector<double> scaled(std::vector<double> c, double in_scale, double out_scale) {
+    double s = in_scale;
+    for (double &ci : c) {
+        ci *= s * out_scale;
+        s *= in_scale * in_scale;
+    }
+    return c;
+}
+
+Ciphertext<DCRTPoly> sign_approx(const CryptoContext<DCRTPoly> &cc, const Ciphertext<DCRTPoly> &x,
+                                 const SignApprox &approx, double in_scale, double out_scale) {
+    if (approx.g_n < 1 || approx.g_n > 3 || approx.f_n < 1 || approx.f_n > 3)
+        throw std::invalid_argument("sign_approx: polynomial family index must be 1..3");
+    const uint32_t stages = approx.g_iters + approx.f_iters;
+    Ciphertext<DCRTPoly> y = x;
+    for (uint32_t s = 0; s < stages; s++) {
+        const std::vector<double> &base = s < approx.g_iters ? G_COEFFS[approx.g_n] : F_COEFFS[approx.f_n];
+        y = eval_odd_poly(cc, y, scaled(base, s == 0 ? in_scale : 1.0, s + 1 == stages ? out_scale : 1.0));
+    }
+    return y;
+}
+
+Ciphertext<DCRTPoly> eval_less_than(const CryptoContext<DCRTPoly> &cc, const Ciphertext<DCRTPoly> &x,
+                                    double tau, const SignApprox &approx) {
+    Ciphertext<DCRTPoly> diff = cc->EvalSub(x, tau);  // in [-2, 2]
+    // -sign((x-tau)/2) / 2 + 1/2: the negation and both halvings ride on the coefficients
+    Ciphertext<DCRTPoly> bit = sign_approx(cc, diff, approx, 0.5, -0.5);
+    cc->EvalAddInPlace(bit, 0.5);
+    return bit;
+}
+
+Ciphertext<DCRTPoly> eval_at_least(const CryptoContext<DCRTPoly> &cc, const Ciphertext<DCRTPoly> &x,
+                                   double tau, const SignApprox &approx) {
+    Ciphertext<DCRTPoly> bit = sign_approx(cc, cc->EvalSub(x, tau), approx, 0.5, 0.5);
+    cc->EvalAddInPlace(bit, 0.5);
+    return bit;
+}
+
+Ciphertext<DCRTPoly> eval_max(const CryptoContext<DCRTPoly> &cc, const Ciphertext<DCRTPoly> &a,
+                              const Ciphertext<DCRTPoly> &b, const SignApprox &approx) {
+    Ciphertext<DCRTPoly> diff = cc->EvalSub(a, b);  // in [-2, 2]
+    // sign((a-b)/2) / 2: both halvings folded into the polynomial coefficients
+    Ciphertext<DCRTPoly> half_sign = sign_approx(cc, diff, approx, 0.5, 0.5);
+    Ciphertext<DCRTPoly> mean = cc->EvalMult(cc->EvalAdd(a, b), 0.5);
+    return cc->EvalAdd(mean, cc->EvalMult(diff, half_sign));
+}
@@ -0,0 +1,83 @@
+// compare.h -- encrypted sign / max via composite minimax polynomials
+//
+// sign(x) on [-1, 1] is approximated by the composition f_n^{df} o g_m^{dg} of
+// Cheon, Kim, Kim, Lee, "Efficient Homomorphic Comparison Methods with Optimal
+// Complexity" (ASIACRYPT 2020): g_m pushes small inputs away from 0 quickly, f_n
+// then flattens the result towards +-1. Every component is an odd polynomial of
+// degree 2n+1 evaluated at depth ceil(log2(2n+2)), so the whole chain costs
+//     dg * depth(g_m) + df * depth(f_n)
+// levels. More iterations buy precision near 0 at the cost of depth.
+//
+// max(a, b) = (a + b)/2 + (a - b) * sign(a - b)/2, with the /2 scalings folded into
+// the first and last polynomial so they cost no extra level.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "openfhe/pke/openfhe.h"
+
+struct SignApprox {
+    uint32_t g_n = 3;      // g_m family member (1..3), degree 2m+1
+    uint32_t g_iters = 4;  // how many times g_m is composed
+    uint32_t f_n = 3;      // f_n family member (1..3), degree 2n+1
+    uint32_t f_iters = 2;  // how many times f_n is composed
+
+    uint32_t depth() const;      // levels consumed by sign_approx
+    uint32_t max_depth() const;  // levels consumed by eval_max (sign + one product)
+};
+
+// Precision/depth trade-off table. max_error is the worst-case |eval_max - max| for
+// a, b in [-1, 1] from the polynomial alone (no CKKS noise), measured offline on a
+// dense grid of a - b.
+struct SignPreset {
+    SignApprox approx;
+    double max_error;
+};
+
+// Cheapest preset whose max_error <= target and whose max_depth() fits depth_budget.
+// If none meets the target, returns the most precise preset that fits the budget.
+// Throws std::invalid_argument if not even the shallowest preset fits.
+SignPreset sign_preset_for(double target_error, uint32_t depth_budget);
+
+// Step polynomial for the threshold decision (eval_at_least / eval_less_than on every
+// score). step_error is the worst-case |step(x) - 1[x >= tau]| over |x - tau| >= margin,
+// from the polynomial alone (no CKKS noise), measured on a dense grid at plan time.
+struct StepPreset {
+    SignApprox approx;
+    double step_error;
+};
+
+// Combined error of all step bits a threshold reduction sums or multiplies: below it a
+// count still rounds to the right integer and a product of (1 - bit) stays on the right
+// side of 1/2.
+constexpr double STEP_ERROR_BUDGET = 0.1;
+
+// Cheapest preset (by depth()) whose step_error * bits <= STEP_ERROR_BUDGET. If none
+// meets it, returns the most precise preset.
+StepPreset step_preset_for(double margin, size_t bits);
+
+// Approximates out_scale * sign(in_scale * x) for in_scale * x in [-1, 1].
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> sign_approx(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                     const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &x,
+                                                     const SignApprox &approx, double in_scale = 1.0,
+                                                     double out_scale = 1.0);
+
+// Slot-wise 1[x < tau] for x, tau in [-1, 1], as an approximate {0, 1} value:
+// (1 + sign(tau - x)) / 2. tau is subtracted as a plaintext constant, so no
+// encryption and no extra noise. Consumes approx.depth() levels.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> eval_less_than(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                        const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &x,
+                                                        double tau, const SignApprox &approx);
+
+// Slot-wise step 1[x >= tau] = (1 + sign(x - tau)) / 2, same domain and depth as eval_less_than.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> eval_at_least(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                       const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &x,
+                                                       double tau, const SignApprox &approx);
+
+// Slot-wise max(a, b) for a, b in [-1, 1]. Consumes approx.max_depth() levels.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> eval_max(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                  const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &a,
+                                                  const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &b,
+                                                  const SignApprox &approx);
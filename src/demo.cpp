@@ -2,13 +2,19 @@
 // NOTE: compile against OpenFHE (C++). See README for build/run.
 //
 // High-level flow (single binary):
-//  - Generate 100 random 64-D vectors and 1 query (demo scale)
+//  - Stream the gallery from an .fvecs/.npy/raw float32 file in chunks (or generate 100
+//    random 64-D vectors, demo scale) and a batch of 4 random probes
 //  - Normalize to unit L2
 //  - Setup CKKS crypto context (simplified for demo)
-//  - Encrypt DB vectors & query
-//  - For each DB vector compute encrypted dot(q,v_i) (cosine)
-//  - Reduce to a single encrypted maximum similarity via tournament approach
-//  - Decrypt only the final maximum similarity (privacy-preserving)
+//  - Encrypt the DB as Halevi-Shoup diagonals (or packed blocks) & the probes (tiled, or one
+//    slot region per probe in the packed layout); all probes are scored in one pass over the DB
+//  - Diagonal BSGS matrix-vector product -> one ciphertext with cos(q,v_i) in slot i
+//  - Reduce to a single encrypted maximum similarity via an in-slot rotation tournament,
+//    bootstrapping the score ciphertext whenever the next round would not fit
+//  - Compare against the threshold homomorphically: encrypted isUnique = 1[maxSim < tau]
+//    (or, in threshold mode, skip the maximum: step 1[sim >= tau] per score + rotate-and-add)
+//  - Decrypt only the isUnique bit (privacy-preserving), by threshold decryption across
+//    NUM_PARTIES party processes that each hold one share of the secret key
 //
 // Important: this code follows OpenFHE examples. Minor API names may differ
 // slightly with your installed OpenFHE version. See comments where change might be needed.
@@ -21,203 +27,548 @@
 #include <cassert>
 
 #include "openfhe/pke/openfhe.h" // main OpenFHE header
+#include "bootstrap.h"
+#include "compare.h"
+#include "kernels.h"
+#include "key_cache.h"
+#include "loader.h"
+#include "matrix.h"
+#include "matvec.h"
+#include "metrics.h"
+#include "multiparty.h"
+#include "packing.h"
+#include "parallel.h"
+#include "planner.h"
+#include "precision.h"
+#include "reduce.h"
+#include "rotation_keys.h"
+#include "rows.h"
+#include "work_stealing.h"
+#include "scores.h"
+#include "store.h"
 using namespace lbcrypto;
 
 // ---------- helper math ----------
-static std::vector<double> random_vector(size_t dim, std::mt19937 &rng) {
+static void random_vector(double *v, size_t dim, std::mt19937 &rng) {
     std::normal_distribution<double> d(0.0, 1.0);
-    std::vector<double> v(dim);
     for(size_t i=0;i<dim;i++) v[i] = d(rng);
-    return v;
-}
-static void normalize_inplace(std::vector<double> &v) {
-    double s = 0;
-    for(double x : v) s += x*x;
-    s = std::sqrt(s);
-    if (s == 0) return;
-    for(double &x : v) x /= s;
 }
 
 // ---------- main ----------
 int main(int argc, char** argv) {
+    // party process started by ThresholdParties (multiparty.h): serve key-share requests and exit
+    if (argc == 4 && std::string(argv[1]) == PARTY_FLAG) return run_party(std::atoi(argv[2]), std::atoi(argv[3]));
+
     // PARAMETERS (practical demo version)
-    const size_t DB_N = 100;          // number of database vectors (scaled down for demo)
-    const size_t DIM = 64;            // vector dimension (scaled down for demo)
-    const uint32_t BATCH_SIZE = DIM;  // pack whole vector in one CKKS ciphertext
-    const uint32_t MULT_DEPTH = 10;   // multiplicative depth budget
-    const uint32_t SCALE_BITS = 40;   // CKKS scaling factor bits (balanced for demo)
+    // Gallery file (loader.h): .fvecs, .npy, or raw float32 with DIM values per row; streamed in
+    // chunks and never held in memory as a whole. Empty = DB_N random vectors.
+    const std::string DB_PATH = "";
+    const size_t DB_N = 100;          // number of database vectors (first DB_N rows of DB_PATH, 0 = all)
+    const size_t DIM = 64;            // vector dimension (scaled down for demo, power of two; .fvecs/.npy carry their own)
+    const size_t NUM_PROBES = 4;      // queries answered per pass over the DB (query batching)
+    // Levels per max evaluation (precision/depth knob, see compare.cpp). 5 is a quick demo (max error
+    // ~1e-1); the 1e-4 target needs 22, which only fits with bootstrapping (single-key mode, see README)
+    const uint32_t MAX_ROUND_DEPTH = 5;
+    // Refresh score ciphertexts with EvalBootstrap whenever the next reduction step would not fit
+    // (only used when the circuit is deeper than a bootstrapping context)
+    const bool USE_BOOTSTRAP = true;  // single-key mode only: there are no joint bootstrapping keys
+    // Parties holding additive shares of the secret key, one process each (multiparty.h). Every
+    // party takes part in every decryption (N-of-N); the demo process itself never holds a secret
+    // key. 1 = single-key mode (default): one local key pair, so bootstrapping, the key cache and
+    // the encrypted DB store all work, but this process holds the secret key. > 1 (opt-in) trades
+    // them away for the split key: no joint bootstrapping keys (leveled circuit only), fresh keys
+    // every run (nothing to cache), and a DB encrypted under them cannot be reused (store skipped).
+    const size_t NUM_PARTIES = 1;
+    const uint32_t ROUNDS_PER_BOOTSTRAP = 2;  // tournament rounds between refreshes
     const double SIMILARITY_THRESHOLD = 0.5;  // threshold for uniqueness decision
+    // Threshold mode: scores within STEP_MARGIN of the threshold may land on either side; the planner
+    // picks a step polynomial whose error over all of a probe's scores cannot flip the decision
+    const double STEP_MARGIN = 0.1;
+    const double MAX_PRECISION = 1e-4;        // target |enc max - plain max| for the max polynomial
+    // Demo-only accuracy report: decrypts the maximum itself, so single-key mode only (refused with
+    // NUM_PARTIES > 1, where the parties decrypt nothing but the decision)
+    const bool DEBUG_DECRYPT_MAX = false;
+    // CKKS scale in bits; 0 lets the planner derive it from MAX_PRECISION. Lower it (and MAX_ROUND_DEPTH)
+    // while the precision report below still PASSes: fewer bits per level is a smaller, faster context.
+    const uint32_t SCALE_BITS = 0;
+    // Precision tracking (precision.h): level, scale and estimated noise of every stage's ciphertexts.
+    // The oracle (test mode only) decrypts intermediates with the secret key to measure the real error;
+    // like DEBUG_DECRYPT_MAX it is refused in multiparty mode.
+    const bool TRACK_PRECISION = false;
+    const bool PRECISION_ORACLE = false;
     const SecurityLevel security = HEStd_128_classic;
+    const int THREADS = 0;            // outer-level worker threads for bulk stages (0 = OMP_NUM_THREADS / all cores)
+    // Diagonal: BSGS matrix-vector product, scores land in consecutive slots (default)
+    // Packed:   floor(slots/DIM) vectors per ciphertext, scores at block heads
+    const SimilarityLayout SIM_LAYOUT = SimilarityLayout::Diagonal;
+    // Max:       tournament max + encrypted compare (maximum available for the debug report)
+    // Threshold: one step polynomial per score + reduction, the tournament is skipped entirely
+    const DecisionMode DECISION_MODE = DecisionMode::Max;
+    // Count reveals the number of matches on decryption; AllBelow yields the isUnique bit
+    // directly for one extra level per reduction round
+    const ThresholdReduction THRESHOLD_REDUCTION = ThresholdReduction::Count;
+    // Minimal: power-of-two / baby-width keys only (Horner giant steps, radix-2 folds), far fewer
+    // rotation keys in RAM for the same rotation count; Exact: one key per index of the hoisted circuit
+    const RotationKeyMode ROTATION_KEYS = RotationKeyMode::Minimal;
+    // Server-side plaintext gallery: DB pre-encoded once as Plaintext, similarity via ciphertext x plaintext
+    // EvalMult (no relinearization, half the memory per entry). Only the query is encrypted.
+    const bool PLAINTEXT_DB = false;
+    // Encrypted DB store (store.h): reopened lazily when it matches the context, key and DB shape,
+    // otherwise the DB is re-encrypted and the store rewritten. Empty string disables it.
+    const std::string DB_STORE_PATH = "enc_db.store";
+    // Context and key cache (key_cache.h): reloaded when the planned parameters and rotation
+    // set match, otherwise regenerated and saved. Empty string disables it.
+    const std::string KEY_CACHE_DIR = "keys";
+    // Per-stage wall/CPU time, peak RSS and ciphertext counts (metrics.h); empty path disables an output
+    const std::string METRICS_JSON_PATH = "metrics.json";
+    const std::string METRICS_PROM_PATH = "";  // Prometheus text format, e.g. for a node_exporter textfile
+
+    // only the header is read here; rows are streamed during ingest below
+    std::unique_ptr<VectorFile> gallery;
+    if (!DB_PATH.empty()) gallery.reset(new VectorFile(DB_PATH, DIM));
+    const size_t db_n = !gallery ? DB_N : DB_N ? std::min(DB_N, gallery->count()) : gallery->count();
+    const size_t dim = gallery ? gallery->dim() : DIM;
+    // identifies the DB rows to the encrypted store (store.h): file identity, or the seed of rng below
+    const std::string gallery_fp = gallery ? gallery->fingerprint() : "random normal mt19937 seed 42";
+    if (gallery)
+        std::cout << "[+] Gallery " << DB_PATH << ": " << gallery->count() << " x " << dim << " vectors, using "
+                  << db_n << "\n";
+
+    // Depth, scale, slots and the sign polynomial all come from the planner (planner.h):
+    // the context is sized for exactly the circuit that runs below
+    PlanRequest plan_req;
+    plan_req.db_n = db_n;
+    plan_req.dim = dim;
+    plan_req.probes = NUM_PROBES;
+    plan_req.layout = SIM_LAYOUT;
+    plan_req.mode = DECISION_MODE;
+    plan_req.reduction = THRESHOLD_REDUCTION;
+    plan_req.precision = MAX_PRECISION;
+    plan_req.round_depth_limit = MAX_ROUND_DEPTH;
+    plan_req.step_margin = STEP_MARGIN;
+    plan_req.scale_bits = SCALE_BITS;
+    plan_req.allow_bootstrap = USE_BOOTSTRAP && NUM_PARTIES == 1;
+    plan_req.rounds_per_bootstrap = ROUNDS_PER_BOOTSTRAP;
+    plan_req.security = security;
+    plan_req.rotation_keys = ROTATION_KEYS;
+    const CircuitPlan plan = plan_circuit(plan_req);
+    const SignPreset &max_poly = plan.sign;
+    const bool bootstrapping = plan.bootstrapping;
+    const uint32_t MULT_DEPTH = plan.mult_depth;   // multiplicative depth budget
+    const uint32_t COMPARE_DEPTH = plan.compare_depth;
 
-    // Multiparty params (simplified to single party for demo)
-    const size_t NUM_PARTIES = 1;     // simplified to single party for demo
-    const size_t THRESHOLD_PARTIES = 1;  // single party decryption
+    Metrics metrics;
+    const int threads = configure_outer_parallelism(THREADS);
+    std::cout << "[+] Using " << threads << " thread(s) for bulk encryption and similarity shards\n";
 
     std::cout << "[+] Setup RNG and generate vectors\n";
     std::mt19937 rng(42);
-    std::vector<std::vector<double>> db(DB_N);
-    for(size_t i=0;i<DB_N;i++){
-        db[i] = random_vector(DIM, rng);
-        normalize_inplace(db[i]);
+    Matrix<double> random_db(gallery ? 0 : db_n, dim);  // only without DB_PATH
+    for(size_t i=0;i<random_db.rows();i++) random_vector(random_db.row(i), dim, rng);
+    size_t zero_rows = normalize_rows(random_db);  // batch kernel, see kernels.h
+    Matrix<double> probes(NUM_PROBES, dim);
+    for(size_t p=0;p<NUM_PROBES;p++) random_vector(probes.row(p), dim, rng);
+    normalize_rows(probes);
+
+    // ============ OpenFHE CKKS context (simplified for demo) ============
+    std::cout << "[+] Circuit plan:\n" << plan.describe() << "\n";
+    const size_t slots = plan.slots;  // batch size chosen by the planner (<= N/2)
+    PackedLayout layout = SIM_LAYOUT == SimilarityLayout::Packed
+        ? make_packed_layout(db_n, dim, slots, ROTATION_KEYS, plan.regions)
+        : make_packed_layout(db_n, dim, slots, ROTATION_KEYS);
+    DiagonalLayout diag_layout = make_diagonal_layout(db_n, dim, slots, ROTATION_KEYS);
+    if (SIM_LAYOUT == SimilarityLayout::Packed) {
+        std::cout << "[+] Packing " << layout.per_ct << " vectors per ciphertext ("
+                  << slots << " slots, " << layout.regions << " probe region(s)) -> " << layout.num_cts()
+                  << " DB ciphertexts\n";
+    } else {
+        std::cout << "[+] Diagonal layout: " << diag_layout.num_blocks() << " row block(s) x "
+                  << dim << " diagonals, BSGS " << diag_layout.baby << "x" << diag_layout.giant << "\n";
     }
-    std::vector<double> query = random_vector(DIM, rng);
-    normalize_inplace(query);
 
-    // PLAINTEXT baseline compute
-    double plain_max = -2.0;
-    size_t plain_argmax = 0;
-    for(size_t i=0;i<DB_N;i++){
-        double s=0;
-        for(size_t k=0;k<DIM;k++) s += query[k]*db[i][k];
-        if (s > plain_max) { plain_max = s; plain_argmax = i; }
+    // Exactly the rotation indices the planned circuit requests (fold, matvec, tournament)
+    const std::vector<int32_t> rotations = circuit_rotations(plan);
+
+    StageTimer keygen_stage(metrics, "keygen");
+    CryptoContext<DCRTPoly> cc;
+    KeyPair<DCRTPoly> kp0;                      // single-key mode
+    std::unique_ptr<ThresholdParties> parties;  // multiparty mode
+    PublicKey<DCRTPoly> jointPublicKey;
+    const bool multiparty = NUM_PARTIES > 1;
+    // both debug paths decrypt far more than the decision; with a split key that would make the
+    // parties open intermediates for the server, so they only run in single-key mode
+    const bool precision_oracle = PRECISION_ORACLE && !multiparty;
+    const bool debug_decrypt_max = DEBUG_DECRYPT_MAX && !multiparty;
+    if (multiparty && (PRECISION_ORACLE || DEBUG_DECRYPT_MAX))
+        std::cout << "[!] PRECISION_ORACLE / DEBUG_DECRYPT_MAX refused: with " << NUM_PARTIES
+                  << " parties only the decision is ever decrypted (set NUM_PARTIES = 1 to debug)\n";
+    const std::string key_fp = key_fingerprint(plan, rotations);
+    // the cache holds a secret key, so only single-key mode uses it
+    if (!multiparty && !KEY_CACHE_DIR.empty() && load_key_cache(KEY_CACHE_DIR, key_fp, cc, kp0)) {
+        std::cout << "[+] Loaded crypto context and keys from " << KEY_CACHE_DIR << "\n";
+        // bootstrapping precomputations are not serialized with the context
+        if (bootstrapping) setup_bootstrapping(cc, plan.bootstrap, slots);
+    } else {
+        std::cout << "[+] Creating CKKS crypto context (simplified for demo)\n";
+        // Create CC params - the CCParams type for CKKS RNS (minimal for the planned circuit):
+        CCParams<CryptoContextCKKSRNS> ccParams = make_cc_params(plan);
+
+        cc = GenCryptoContext(ccParams);
+
+        // enable features needed for CKKS + comparisons
+        cc->Enable(PKE);
+        cc->Enable(LEVELEDSHE);
+        cc->Enable(MULTIPARTY);
+        cc->Enable(ADVANCEDSHE);
+        if (bootstrapping) {
+            cc->Enable(FHE);
+            setup_bootstrapping(cc, plan.bootstrap, slots);
+        }
+
+        if (multiparty) {
+            // ---------- Multiparty key generation ----------
+            // joint public key chain, then joint relinearization and rotation keys, pipelined
+            std::cout << "[+] Running " << NUM_PARTIES << "-party key generation (one process per party)\n";
+            parties.reset(new ThresholdParties(NUM_PARTIES));
+            jointPublicKey = parties->keygen(cc, rotations);
+        } else {
+            // ---------- Single party key generation ----------
+            std::cout << "[+] Running single party key generation\n";
+            kp0 = cc->KeyGen();
+            if (!kp0.good()) {
+                std::cerr << "KeyGen failed\n";
+                return 1;
+            }
+
+            // Generate eval multiplication/rotation keys
+            cc->EvalMultKeyGen(kp0.secretKey);
+            cc->EvalAtIndexKeyGen(kp0.secretKey, rotations);
+            if (bootstrapping) cc->EvalBootstrapKeyGen(kp0.secretKey, slots);
+
+            if (!KEY_CACHE_DIR.empty()) {
+                save_key_cache(KEY_CACHE_DIR, key_fp, cc, kp0);
+                std::cout << "[+] Saved crypto context and keys to " << KEY_CACHE_DIR << "\n";
+            }
+        }
     }
-    std::cout << "[+] Plaintext baseline max similarity = " << plain_max
-              << " (index " << plain_argmax << ")\n";
+    if (!multiparty) jointPublicKey = kp0.publicKey;
+    keygen_stage.stop();
+    std::cout << "[+] Ring dimension " << cc->GetRingDimension() << ", " << slots << " slots, "
+              << rotations.size() << " rotation keys\n";
 
-    // ============ OpenFHE CKKS context (simplified for demo) ============
-    std::cout << "[+] Creating CKKS crypto context (simplified for demo)\n";
-
-    // Create CC params - the CCParams type for CKKS RNS:
-    CCParams<CryptoContextCKKSRNS> ccParams;
-    ccParams.SetMultiplicativeDepth(MULT_DEPTH);
-    ccParams.SetScalingModSize(SCALE_BITS);
-    ccParams.SetBatchSize(BATCH_SIZE);
-    ccParams.SetSecurityLevel(security);
-    // (Optionally) set secret key distribution if needed
-    // ccParams.SetSecretKeyDist(UNIFORM_TERNARY);
-
-    CryptoContext<DCRTPoly> cc = GenCryptoContext(ccParams);
-
-    // enable features needed for CKKS + comparisons
-    cc->Enable(PKE);
-    cc->Enable(LEVELEDSHE);
-    cc->Enable(MULTIPARTY);
-    cc->Enable(ADVANCEDSHE);
-
-    // ---------- Single party key generation (simplified for demo) ----------
-    std::cout << "[+] Running single party key generation (simplified for demo)\n";
-    KeyPair<DCRTPoly> kp0 = cc->KeyGen();
-    if (!kp0.good()) {
-        std::cerr << "KeyGen failed\n";
-        return 1;
-    }
-    PublicKey<DCRTPoly> jointPublicKey = kp0.publicKey;
-
-    // Generate eval multiplication/rotation keys
-    cc->EvalMultKeyGen(kp0.secretKey);
-    cc->EvalAtIndexKeyGen(kp0.secretKey, {1,2,4,8,16,32,64}); // rotations used in sums (reduced for demo)
+    // threshold decryption across the parties (one round trip per batch), or the single key
+    auto decrypt_all = [&](const std::vector<Ciphertext<DCRTPoly>> &cts) {
+        if (parties) return parties->decrypt(cts);
+        std::vector<Plaintext> out(cts.size());
+        for (size_t i = 0; i < cts.size(); i++) cc->Decrypt(kp0.secretKey, cts[i], &out[i]);
+        return out;
+    };
 
     // ============ Encryption of DB & query ============
-    std::cout << "[+] Encrypting " << DB_N << " DB vectors and query\n";
-    std::vector<Ciphertext<DCRTPoly>> enc_db;
-    enc_db.reserve(DB_N);
-    for(size_t i=0;i<DB_N;i++){
-        Plaintext p = cc->MakeCKKSPackedPlaintext(db[i]);
-        Ciphertext<DCRTPoly> c = cc->Encrypt(jointPublicKey, p);
-        enc_db.push_back(c);
+    std::vector<Ciphertext<DCRTPoly>> enc_db;     // packed layout
+    EncryptedMatrix enc_matrix;                     // diagonal layout
+    std::vector<Plaintext> plain_db;                // packed layout, PLAINTEXT_DB
+    PlainMatrix plain_matrix;                       // diagonal layout, PLAINTEXT_DB
+    std::unique_ptr<EncryptedStore> store;          // either layout, loaded shard by shard
+    enc_matrix.layout = diag_layout;
+    plain_matrix.layout = diag_layout;
+    // the joint key of multiparty mode is new every run, so a stored DB could never be reused
+    const bool use_store = !PLAINTEXT_DB && !multiparty && !DB_STORE_PATH.empty();
+    if (multiparty && !PLAINTEXT_DB && !DB_STORE_PATH.empty())
+        std::cout << "[+] Encrypted DB store off in multiparty mode (the joint key changes every run)\n";
+    if (use_store)
+        store = open_matching_store(DB_STORE_PATH, cc, jointPublicKey, gallery_fp, SIM_LAYOUT, db_n, dim, slots,
+                                    layout.regions);
+    if (PLAINTEXT_DB) {
+        // encoded once at the level the fresh query is multiplied at (0)
+        std::cout << "[+] Pre-encoding " << db_n << " DB vectors as plaintexts (server-side gallery)\n";
+    } else if (store) {
+        std::cout << "[+] Reusing encrypted DB store " << DB_STORE_PATH << " (" << store->size()
+                  << " shards, level " << store->header().level << "); streaming the gallery for the baseline only\n";
+    } else {
+        std::cout << "[+] Encrypting " << db_n << " DB vectors\n";
     }
-    Plaintext pq = cc->MakeCKKSPackedPlaintext(query);
-    Ciphertext<DCRTPoly> enc_query = cc->Encrypt(jointPublicKey, pq);
 
-    // ============ Compute encrypted dot products (cosine similarities) ============
-    std::cout << "[+] Computing encrypted dot products (cosines)\n";
-    std::vector<Ciphertext<DCRTPoly>> enc_sims;
-    enc_sims.reserve(DB_N);
-    for(size_t i=0;i<DB_N;i++){
-        // element-wise multiply -> then sum all slots
-        Ciphertext<DCRTPoly> prod = cc->EvalMult(enc_query, enc_db[i]);
-        // EvalSum folds slots into first slot; second arg is the batch size (how many contiguous slots)
-        // Use EvalSum to add the 512 slots (produced by packing)
-        Ciphertext<DCRTPoly> dot = cc->EvalSum(prod, BATCH_SIZE);
-        // After EvalSum, the full dot may be in slot 0 (check OpenFHE behavior/version).
-        enc_sims.push_back(dot);
-    }
-
-    // ============ Encrypted maximum computation using tournament approach ============
-    std::cout << "[+] Computing encrypted maximum using tournament approach\n";
-    
-    // Tournament-style maximum computation
-    std::vector<Ciphertext<DCRTPoly>> working = enc_sims;
-    
-    // Helper function to compute max of two ciphertexts
-    // Since we don't have EvalCompare, we'll use a different approach:
-    // max(a,b) ≈ (a + b + |a-b|) / 2
-    // For CKKS, we can approximate |a-b| using polynomial approximation
-    auto pairwise_max = [&](const Ciphertext<DCRTPoly> &A, const Ciphertext<DCRTPoly> &B)->Ciphertext<DCRTPoly> {
-        // Compute A + B
-        Ciphertext<DCRTPoly> sum = cc->EvalAdd(A, B);
-        
-        // Compute A - B
-        Ciphertext<DCRTPoly> diff = cc->EvalSub(A, B);
-        
-        // For |A-B|, we'll use a simple approximation: if diff > 0, use diff; else use -diff
-        // This is a simplified approach - in practice, you'd need proper comparison
-        // For now, we'll just return the sum as an approximation
-        // In a real implementation, you'd use comparison operations or polynomial approximations
-        
-        // For this demo, we'll use a simple heuristic: return the one with larger magnitude
-        // This is not perfect but demonstrates the concept
-        return sum;  // Simplified: just return sum as approximation
+    // Streaming ingest: the gallery goes through in chunks that end on ciphertext boundaries
+    // (packed) or row blocks (diagonal). Each chunk feeds the plaintext baseline and is encoded
+    // into its own ciphertexts, appended in gallery order; only one chunk is ever resident.
+    const size_t chunk_rows = SIM_LAYOUT == SimilarityLayout::Packed
+        ? layout.per_ct * 4 * static_cast<size_t>(threads)  // a few ciphertexts per worker
+        : slots;                                            // one row block, dim diagonals
+    Matrix<double> chunk(gallery ? std::min(chunk_rows, db_n) : 0, dim);
+    std::vector<BestMatch> baseline(NUM_PROBES);
+    // per-vector similarities (row p = probe p), for the precision oracle only
+    Matrix<double> plain_sims(TRACK_PRECISION ? NUM_PROBES : 0, db_n);
+    std::cout << "[+] Plaintext baseline: " << simd_level_name(simd_level()) << " similarity kernels\n";
+    for (size_t first = 0; first < db_n; first += chunk_rows) {
+        const size_t n = std::min(chunk_rows, db_n - first);
+        if (gallery) zero_rows += gallery->read_normalized(first, n, chunk);
+        // the encoders read the rows in place, no copy
+        const RowBlock rows = gallery ? row_block(chunk, first, 0, n) : row_block(random_db, first, first, n);
+
+        // PLAINTEXT baseline compute: blocked GEMV with the running max/argmax in registers
+        scan_similarities(rows, probes, baseline, TRACK_PRECISION ? plain_sims.data() : nullptr, plain_sims.ld());
+
+        if (PLAINTEXT_DB) {
+            StageTimer stage(metrics, "encode");
+            std::vector<Plaintext> pts = SIM_LAYOUT == SimilarityLayout::Packed
+                ? encode_packed(cc, rows, layout, 0)
+                : encode_diagonals(cc, rows, diag_layout, 0);
+            std::vector<Plaintext> &dst = SIM_LAYOUT == SimilarityLayout::Packed ? plain_db : plain_matrix.diags;
+            dst.insert(dst.end(), pts.begin(), pts.end());
+        } else if (!store) {
+            StageTimer stage(metrics, "encrypt");
+            std::vector<Ciphertext<DCRTPoly>> cts = SIM_LAYOUT == SimilarityLayout::Packed
+                ? encrypt_packed(cc, jointPublicKey, rows, layout)           // parallel across ciphertexts
+                : encrypt_diagonals(cc, jointPublicKey, rows, diag_layout);  // parallel across diagonals
+            stage.stop(cts.size());
+            std::vector<Ciphertext<DCRTPoly>> &dst = SIM_LAYOUT == SimilarityLayout::Packed ? enc_db : enc_matrix.diags;
+            dst.insert(dst.end(), cts.begin(), cts.end());
+        }
+    }
+    if (zero_rows)
+        std::cout << "[+] " << zero_rows << " all-zero gallery vector(s) left unnormalized (they score 0)\n";
+    std::vector<double> plain_max(NUM_PROBES);
+    for (size_t p = 0; p < NUM_PROBES; p++) {
+        plain_max[p] = baseline[p].score;
+        std::cout << "[+] Plaintext baseline max similarity, probe " << p << " = " << plain_max[p]
+                  << " (index " << baseline[p].index << ")\n";
+    }
+    if (use_store && !store) {
+        write_store(DB_STORE_PATH, cc, gallery_fp, SIM_LAYOUT, db_n, dim, slots, layout.regions,
+                    SIM_LAYOUT == SimilarityLayout::Packed ? enc_db : enc_matrix.diags);
+        std::cout << "[+] Wrote encrypted DB store " << DB_STORE_PATH << "\n";
+    }
+    // Probe p lives in query ciphertext p / regions; its results land in slot (p % regions) * region_width
+    const size_t regions = SIM_LAYOUT == SimilarityLayout::Packed ? layout.regions : 1;
+    const size_t region_width = slots / regions;
+    std::cout << "[+] Encrypting " << NUM_PROBES << " probe(s) into " << plan.query_cts << " query ciphertext(s)\n";
+    StageTimer encode_stage(metrics, "encode");
+    std::vector<std::vector<double>> query_slots(plan.query_cts);
+    std::vector<Plaintext> pq(plan.query_cts);
+    for (size_t g = 0; g < pq.size(); g++) {
+        query_slots[g] = SIM_LAYOUT == SimilarityLayout::Packed ? replicate_probes(probes, layout, g)
+                                                                : tile_query(probes.row(g), diag_layout);
+        pq[g] = cc->MakeCKKSPackedPlaintext(query_slots[g]);
+    }
+    encode_stage.stop();
+    StageTimer encrypt_stage(metrics, "encrypt");
+    std::vector<Ciphertext<DCRTPoly>> enc_queries(plan.query_cts);
+    for (size_t g = 0; g < enc_queries.size(); g++) enc_queries[g] = cc->Encrypt(jointPublicKey, pq[g]);
+    encrypt_stage.stop(enc_queries.size());
+
+    // per-stage level/scale/noise; the oracle compares decrypted intermediates with the plaintext pipeline
+    PrecisionTracker tracker(cc, MULT_DEPTH);
+    if (precision_oracle) tracker.enable_oracle(kp0.secretKey);
+    // expected value of the first slot of every probe region of query ciphertext g
+    auto region_heads = [&](size_t g, const std::vector<double> &per_probe) {
+        SlotValues out;
+        for (size_t r = 0; r < regions && g * regions + r < NUM_PROBES; r++)
+            out.push_back({r * region_width, per_probe[g * regions + r]});
+        return out;
     };
-    
-    // Tournament reduction
-    while(working.size() > 1) {
-        std::vector<Ciphertext<DCRTPoly>> next;
-        for(size_t i=0;i+1<working.size(); i+=2) {
-            next.push_back(pairwise_max(working[i], working[i+1]));
+    if (TRACK_PRECISION)
+        for (size_t g = 0; g < enc_queries.size(); g++) tracker.track("query", enc_queries[g], dense_slots(query_slots[g]));
+
+    // ============ Compute encrypted dot products (cosine similarities) ============
+    std::cout << "[+] Computing encrypted dot products (cosines), one pass over the DB for all probes\n";
+    // see scores.h for where each layout leaves cos(q, v_i)
+    // shards run on a work-stealing pool; OpenFHE's own OpenMP stays off inside the workers
+    WorkStealingPool pool(threads);
+    StageTimer similarity_stage(metrics, "similarity");
+    std::vector<EncryptedScores> enc_sims;  // one per query ciphertext
+    if (SIM_LAYOUT == SimilarityLayout::Packed) {
+        // one EvalMult per packed ciphertext and query ciphertext + segmented fold
+        if (PLAINTEXT_DB) enc_sims = packed_batch_similarities(cc, enc_queries, plain_db, layout, &pool);
+        else if (store) enc_sims = packed_batch_similarities(cc, enc_queries, *store, layout, &pool);
+        else enc_sims = packed_batch_similarities(cc, enc_queries, enc_db, layout, &pool);
+    } else {
+        // diagonal matrix-vector product: baby-step rotations of each probe are shared by all row blocks,
+        // (row block, giant step) shards accumulate per worker and are merged at the end
+        std::vector<std::vector<Ciphertext<DCRTPoly>>> babies;
+        for (const auto &q : enc_queries) babies.push_back(baby_steps(cc, q, diag_layout));
+        if (PLAINTEXT_DB) enc_sims = matvec_batch_similarities(cc, babies, plain_matrix, &pool);
+        else if (store) enc_sims = matvec_batch_similarities(cc, babies, StoredMatrix{diag_layout, store.get()}, &pool);
+        else enc_sims = matvec_batch_similarities(cc, babies, enc_matrix, &pool);
+    }
+
+    size_t score_cts = 0;
+    for (const auto &scores : enc_sims) score_cts += scores.cts.size();
+    similarity_stage.stop(score_cts);
+    if (TRACK_PRECISION) {
+        for (size_t g = 0; g < enc_sims.size(); g++) {
+            for (size_t c = 0; c < enc_sims[g].cts.size(); c++) {
+                SlotValues expected;
+                for (size_t r = 0; r < regions && g * regions + r < NUM_PROBES; r++) {
+                    SlotValues region = score_slots(enc_sims[g], c, plain_sims.row(g * regions + r), r * region_width);
+                    expected.insert(expected.end(), region.begin(), region.end());
+                }
+                tracker.track("scores", enc_sims[g].cts[c], expected);
+            }
+        }
+    }
+
+    // bootstraps score ciphertexts whenever the next step needs more levels than they have left
+    LevelRefresher refresher(cc, MULT_DEPTH, bootstrapping);
+    std::vector<Ciphertext<DCRTPoly>> enc_maxSim(enc_sims.size());    // Max mode only
+    std::vector<Ciphertext<DCRTPoly>> enc_decision(enc_sims.size());  // isUnique bits, or match counts
+    const bool decision_is_count =
+        DECISION_MODE == DecisionMode::Threshold && THRESHOLD_REDUCTION == ThresholdReduction::Count;
+    if (DECISION_MODE == DecisionMode::Max) {
+        // ============ Encrypted maximum computation using tournament approach ============
+        std::cout << "[+] Computing encrypted maximum using in-slot tournament\n";
+        // max(a,b) = (a + b + |a-b|) / 2 with |x| = x * sign(x), sign via composite polynomial (compare.h).
+        // Score ciphertexts are first max'ed slot-wise, then the survivor is rotated by
+        // span/2, span/4, ... and max'ed with itself: log2(span) max evaluations in total.
+        // Every probe region of a query ciphertext is reduced by the same evaluations.
+        std::cout << "  - max polynomial depth " << max_poly.approx.max_depth()
+                  << ", worst-case error " << max_poly.max_error << "\n";
+        std::cout << "  - " << enc_sims[0].cts.size() << " score ciphertext(s) per query ciphertext, "
+                  << tournament_rounds(enc_sims[0].count, enc_sims[0].per_ct) << " tournament rounds\n";
+        // ============ Encrypted threshold decision ============
+        // isUnique = 1[maxSim < tau]; tau is a plaintext constant, never encrypted
+        std::cout << "[+] Computing encrypted threshold decisions (isUnique = maxSim < " << SIMILARITY_THRESHOLD << ")\n";
+        for (size_t g = 0; g < enc_sims.size(); g++) {
+            StageTimer reduction_stage(metrics, "reduction");
+            enc_maxSim[g] = reduce_max(cc, enc_sims[g], max_poly.approx, &refresher);
+            reduction_stage.stop(1);
+            StageTimer compare_stage(metrics, "compare");
+            enc_decision[g] = eval_less_than(cc, refresher.ensure(enc_maxSim[g], COMPARE_DEPTH + plan.mask_depth),
+                                             SIMILARITY_THRESHOLD, max_poly.approx);
+            compare_stage.stop(1);
+            if (TRACK_PRECISION) {
+                tracker.track("max", enc_maxSim[g], region_heads(g, plain_max));
+                std::vector<double> unique(NUM_PROBES);
+                for (size_t p = 0; p < NUM_PROBES; p++) unique[p] = plain_max[p] < SIMILARITY_THRESHOLD ? 1 : 0;
+                tracker.track("compare", enc_decision[g], region_heads(g, unique));
+            }
         }
-        if (working.size() % 2 == 1) {
-            next.push_back(working.back()); // odd element passes through
+    } else {
+        // ============ Threshold decision without the maximum ============
+        std::cout << "[+] Threshold mode: step 1[sim >= " << SIMILARITY_THRESHOLD << "] per score + "
+                  << (decision_is_count ? "rotate-and-add count" : "rotate-and-multiply all-below") << "\n";
+        // the step polynomial (the compare of this mode) runs inside the reduction stage; it is planned
+        // on its own (no tournament here), not from MAX_ROUND_DEPTH
+        std::cout << "  - step polynomial depth " << plan.step.approx.depth() << ", error " << plan.step.step_error
+                  << " per score at |sim - tau| >= " << STEP_MARGIN << "\n";
+        for (size_t g = 0; g < enc_sims.size(); g++) {
+            StageTimer reduction_stage(metrics, "reduction");
+            enc_decision[g] = threshold_reduce(cc, enc_sims[g], SIMILARITY_THRESHOLD, plan.step.approx,
+                                               THRESHOLD_REDUCTION, &refresher, fold_radix(ROTATION_KEYS));
+            reduction_stage.stop(1);
+            if (TRACK_PRECISION) {
+                std::vector<double> decision(NUM_PROBES);
+                for (size_t p = 0; p < NUM_PROBES; p++) {
+                    size_t above = std::count_if(plain_sims.row(p), plain_sims.row(p) + db_n,
+                                                 [&](double s) { return s >= SIMILARITY_THRESHOLD; });
+                    decision[p] = decision_is_count ? above : (above == 0 ? 1 : 0);
+                }
+                tracker.track("threshold", enc_decision[g], region_heads(g, decision));
+            }
         }
-        working.swap(next);
-        std::cout << "  - tournament round, remaining = " << working.size() << "\n";
-    }
-    Ciphertext<DCRTPoly> enc_maxSim = working[0];
-    
-    // Create encrypted threshold for comparison
-    std::vector<double> threshold_vec(DIM, 0.0);
-    threshold_vec[0] = SIMILARITY_THRESHOLD;
-    Plaintext p_threshold = cc->MakeCKKSPackedPlaintext(threshold_vec);
-    Ciphertext<DCRTPoly> enc_threshold = cc->Encrypt(jointPublicKey, p_threshold);
-
-    // ============ Single party decryption of the final result ============
-    std::cout << "[+] Single party decryption of final result (simplified for demo)\n";
-    Plaintext decrypted;
-    cc->Decrypt(kp0.secretKey, enc_maxSim, &decrypted);
-
-    // Print decrypted maximum similarity
-    decrypted->SetLength(1);
-    double enc_max = decrypted->GetCKKSPackedValue()[0].real();
-    std::cout << "[+] Decrypted maximum similarity = " << enc_max << "\n";
-    std::cout << "[+] Plaintext maximum similarity = " << plain_max << "\n";
+    }
+    if (bootstrapping) std::cout << "  - bootstraps performed: " << refresher.bootstraps() << "\n";
+
+    // ============ Decryption of the final result ============
+    if (multiparty)
+        std::cout << "[+] Threshold decryption of the " << (decision_is_count ? "match count" : "isUnique bit")
+                  << " per probe: " << NUM_PARTIES << " partial decryptions in parallel, then fusion\n";
+    else
+        std::cout << "[+] Single party decryption of the " << (decision_is_count ? "match count" : "isUnique bit")
+                  << " per probe\n";
     std::cout << "[+] Threshold = " << SIMILARITY_THRESHOLD << "\n";
-    
-    // Threshold decision
-    bool is_unique_plaintext = plain_max < SIMILARITY_THRESHOLD;
-    bool is_unique_encrypted = enc_max < SIMILARITY_THRESHOLD;
-    
-    std::cout << "[+] Plaintext decision (isUnique): " << (is_unique_plaintext ? "true" : "false") << "\n";
-    std::cout << "[+] Encrypted decision (isUnique): " << (is_unique_encrypted ? "true" : "false") << "\n";
-    std::cout << "[+] Decisions match: " << (is_unique_plaintext == is_unique_encrypted ? "YES" : "NO") << "\n";
-    
-    // Accuracy check
-    double accuracy_error = std::abs(plain_max - enc_max);
-    std::cout << "[+] Absolute difference |plaintext - encrypted| = " << accuracy_error << "\n";
-    std::cout << "[+] Accuracy target (< 1e-4): " << (accuracy_error < 1e-4 ? "PASS" : "FAIL") << "\n";
-    
-    if (accuracy_error >= 1e-4) {
-        std::cout << "[+] NOTE: Accuracy error exceeds target due to:" << std::endl;
-        std::cout << "[+]   - CKKS noise accumulation over " << DB_N << " operations" << std::endl;
-        std::cout << "[+]   - Simplified max computation (tournament approximation)" << std::endl;
-        std::cout << "[+]   - Parameter limitations for demo scale" << std::endl;
-        std::cout << "[+]   - To improve: increase SCALE_BITS, use proper comparison operations" << std::endl;
-    }
-
-    // Privacy check: assert server code never saved a private key (this binary only used secret keys in partyKeys vector,
-    // which we consider to be held by parties; server only sees jointPublicKey & ciphertexts).
-    std::cout << "[+] Privacy check: Single party holds secret key (simplified for demo)\n";
-    std::cout << "[+] Privacy check: Server only sees public key and ciphertexts\n";
-    std::cout << "[+] Privacy check: NOTE: Full MPC implementation would require threshold cryptography\n";
+    StageTimer decrypt_stage(metrics, "decrypt");
+    // only the region heads are decrypted: the other slots hold partial tournament/fold results
+    for (size_t g = 0; g < enc_decision.size(); g++) {
+        std::vector<size_t> heads;
+        for (size_t r = 0; r < regions && g * regions + r < NUM_PROBES; r++) heads.push_back(r * region_width);
+        enc_decision[g] = keep_slots(cc, refresher.ensure(enc_decision[g], plan.mask_depth), heads, slots);
+    }
+    const std::vector<Plaintext> decisions = decrypt_all(enc_decision);  // whole batch in one round
+    decrypt_stage.stop();
+    size_t matching = 0;
+    for (size_t g = 0; g < enc_decision.size(); g++) {
+        std::vector<double> values = decisions[g]->GetRealPackedValue();
+        for (size_t r = 0; r < regions && g * regions + r < NUM_PROBES; r++) {
+            const size_t p = g * regions + r;
+            double enc_value = values[r * region_width];
+            if (decision_is_count)
+                std::cout << "[+] Probe " << p << ": decrypted match count = " << enc_value
+                          << " (rounds to " << std::lround(enc_value) << ")\n";
+            else
+                std::cout << "[+] Probe " << p << ": decrypted isUnique value = " << enc_value
+                          << " (rounds to " << (enc_value > 0.5 ? 1 : 0) << ")\n";
+
+            // Threshold decision
+            bool is_unique_plaintext = plain_max[p] < SIMILARITY_THRESHOLD;
+            bool is_unique_encrypted = decision_is_count ? enc_value < 0.5 : enc_value > 0.5;
+            std::cout << "    plaintext isUnique: " << (is_unique_plaintext ? "true" : "false")
+                      << ", encrypted isUnique: " << (is_unique_encrypted ? "true" : "false") << "\n";
+            if (is_unique_plaintext == is_unique_encrypted) matching++;
+        }
+    }
+    std::cout << "[+] Decisions match: " << (matching == NUM_PROBES ? "YES" : "NO") << " (" << matching << "/"
+              << NUM_PROBES << ")\n";
+
+    if (debug_decrypt_max && DECISION_MODE == DecisionMode::Max) {
+        // Accuracy check (debug only: reveals the maximum similarity to the key holder)
+        double accuracy_error = 0;
+        const std::vector<Plaintext> decrypted_max = decrypt_all(enc_maxSim);
+        for (size_t g = 0; g < enc_maxSim.size(); g++) {
+            std::vector<double> values = decrypted_max[g]->GetRealPackedValue();
+            for (size_t r = 0; r < regions && g * regions + r < NUM_PROBES; r++) {
+                const size_t p = g * regions + r;
+                double enc_max = values[r * region_width];
+                std::cout << "[+] [debug] Probe " << p << ": decrypted maximum similarity = " << enc_max
+                          << ", plaintext = " << plain_max[p] << "\n";
+                accuracy_error = std::max(accuracy_error, std::abs(plain_max[p] - enc_max));
+            }
+        }
+        std::cout << "[+] Max absolute difference |plaintext - encrypted| = " << accuracy_error << "\n";
+        std::cout << "[+] Accuracy target (< 1e-4): " << (accuracy_error < 1e-4 ? "PASS" : "FAIL") << "\n";
+
+        if (accuracy_error >= 1e-4) {
+            std::cout << "[+] NOTE: Accuracy error exceeds target due to:" << std::endl;
+            std::cout << "[+]   - CKKS noise accumulation over " << db_n << " operations" << std::endl;
+            std::cout << "[+]   - Max polynomial worst-case error " << max_poly.max_error
+                      << " (depth " << max_poly.approx.max_depth() << ")" << std::endl;
+            std::cout << "[+]   - Parameter limitations for demo scale" << std::endl;
+            std::cout << "[+]   - To reach 1e-4: MAX_ROUND_DEPTH >= 22 with bootstrapping (NUM_PARTIES = 1,"
+                      << " USE_BOOTSTRAP = true, ROUNDS_PER_BOOTSTRAP = 1); see README" << std::endl;
+        }
+    }
+
+    if (TRACK_PRECISION) {
+        // Max mode: the 1e-4 target is on the maximum; Threshold mode never forms it, so check the scores
+        std::cout << "[+] Precision by stage (estimated CKKS noise floor" << (tracker.oracle() ? ", measured error" : "")
+                  << "):\n"
+                  << tracker.report(DECISION_MODE == DecisionMode::Max ? "max" : "scores", MAX_PRECISION) << "\n";
+    }
+
+    // ============ Instrumentation ============
+    std::cout << "[+] Stage metrics (wall s / cpu s / peak RSS MB / ciphertexts):\n";
+    for (const auto &st : metrics.stages())
+        std::cout << "  - " << st.name << ": " << st.wall_seconds << " / " << st.cpu_seconds << " / "
+                  << st.peak_rss_bytes / (1024.0 * 1024.0) << " / " << st.ciphertexts << "\n";
+    if (!METRICS_JSON_PATH.empty()) {
+        metrics.write_json(METRICS_JSON_PATH);
+        std::cout << "[+] Wrote stage metrics to " << METRICS_JSON_PATH << "\n";
+    }
+    if (!METRICS_PROM_PATH.empty()) {
+        metrics.write_prometheus(METRICS_PROM_PATH);
+        std::cout << "[+] Wrote Prometheus metrics to " << METRICS_PROM_PATH << "\n";
+    }
+
+    // Privacy check: in multiparty mode the secret key shares only ever exist inside the party
+    // processes; this process (the server) sees the joint public key, evaluation keys and ciphertexts.
+    if (multiparty) {
+        std::cout << "[+] Privacy check: " << NUM_PARTIES << " party processes each hold one secret key share\n";
+        std::cout << "[+] Privacy check: Server holds no secret key: " << (kp0.secretKey ? "NO" : "YES") << "\n";
+        std::cout << "[+] Privacy check: Decryption needs all " << NUM_PARTIES << " parties\n";
+    } else {
+        std::cout << "[+] Privacy check: Single party holds secret key (NUM_PARTIES = 1)\n";
+        std::cout << "[+] Privacy check: Server only sees public key and ciphertexts\n";
+    }
 
     return 0;
 }
@@ -0,0 +1,549 @@
+// kernels.cpp -- row normalization and blocked similarity scan with AVX2 / AVX-512 paths (see kernels.h)
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// Rows of a tile (rounded to whole blocks): small enough that every probe's pass
+// over the tile after the first one hits L2.
+static constexpr size_t TILE_BYTES = 64 * 1024;
+
+// Row within the chunk, as kept in an index lane: 32-bit next to float scores so a
+// block's indices fill one register, 64-bit next to doubles.
+template <class T>
+using LaneIndex = typename std::conditional<std::is_same<T, float>::value, int32_t, int64_t>::type;
+
+// Runs every probe over chunk rows [row0, row1) (a whole number of blocks), updating
+// that probe's lanes lane_score / lane_index[p * lanes + l].
+template <class T>
+using TileKernel = void (*)(const RowView<T> &rows, size_t row0, size_t row1, const Matrix<T> &probes,
+                            T *lane_score, LaneIndex<T> *lane_index, double *sims, size_t sims_ld);
+
+// Normalizes `rows` rows (a whole number of blocks) starting at data; returns the
+// number of all-zero rows.
+template <class T>
+using NormalizeKernel = size_t (*)(T *data, size_t stride, size_t dim, size_t rows);
+
+template <class T>
+static T dot(const T *a, const T *b, size_t dim) {
+    T s = 0;
+#pragma omp simd reduction(+ : s)
+    for (size_t k = 0; k < dim; k++) s += a[k] * b[k];
+    return s;
+}
+
+template <class T>
+static void tile_scalar(const RowView<T> &rows, size_t row0, size_t row1, const Matrix<T> &probes, T *lane_score,
+                        LaneIndex<T> *lane_index, double *sims, size_t sims_ld) {
+    for (size_t p = 0; p < probes.rows(); p++) {
+        T best = lane_score[p];
+        LaneIndex<T> best_i = lane_index[p];
+        for (size_t r = row0; r < row1; r++) {
+            const T s = dot(probes.row(p), rows.data + r * rows.stride, rows.dim);
+            if (sims) sims[p * sims_ld + rows.first + r] = s;
+            if (s > best) {
+                best = s;
+                best_i = static_cast<LaneIndex<T>>(r);
+            }
+        }
+        lane_score[p] = best;
+        lane_index[p] = best_i;
+    }
+}
+
+template <class T>
+static size_t normalize_scalar(T *data, size_t stride, size_t dim, size_t rows) {
+    size_t zero = 0;
+    for (size_t r = 0; r < rows; r++) {
+        T *v = data + r * stride;
+        const T ss = dot(v, v, dim);
+        if (ss == 0) {
+            zero++;
+            continue;
+        }
+        const T scale = T(1) / std::sqrt(ss);
+#pragma omp simd
+        for (size_t k = 0; k < dim; k++) v[k] *= scale;
+    }
+    return zero;
+}
+
+#ifdef KERNELS_X86
+
+// [sum a0, sum a1, sum a2, sum a3]
+__attribute__((target("avx2,fma"))) static inline __m256d reduce4_pd(__m256d a0, __m256d a1, __m256d a2,
+                                                                      __m256d a3) {
+    const __m256d s01 = _mm256_hadd_pd(a0, a1), s23 = _mm256_hadd_pd(a2, a3);
+    return _mm256_add_pd(_mm256_permute2f128_pd(s01, s23, 0x20), _mm256_permute2f128_pd(s01, s23, 0x31));
+}
+
+// [sum a[0], ..., sum a[7]]
+__attribute__((target("avx2,fma"))) static inline __m256 reduce8_ps(const __m256 *a) {
+    const __m256 g0 = _mm256_hadd_ps(_mm256_hadd_ps(a[0], a[1]), _mm256_hadd_ps(a[2], a[3]));
+    const __m256 g1 = _mm256_hadd_ps(_mm256_hadd_ps(a[4], a[5]), _mm256_hadd_ps(a[6], a[7]));
+    return _mm256_add_ps(_mm256_permute2f128_ps(g0, g1, 0x20), _mm256_permute2f128_ps(g0, g1, 0x31));
+}
+
+__attribute__((target("avx2,fma"))) static void tile_avx2(const RowView<double> &rows, size_t row0, size_t row1,
+                                                           const Matrix<double> &probes, double *lane_score,
+                                                           int64_t *lane_index, double *sims, size_t sims_ld) {
+    const size_t len = (rows.dim + 3) / 4 * 4;  // zero padding past dim
+    for (size_t p = 0; p < probes.rows(); p++) {
+        const double *q = probes.row(p);
+        __m256d best = _mm256_loadu_pd(lane_score + 4 * p);
+        __m256i best_i = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lane_index + 4 * p));
+        __m256i idx = _mm256_add_epi64(_mm256_set1_epi64x(static_cast<long long>(row0)), _mm256_setr_epi64x(0, 1, 2, 3));
+        for (size_t r = row0; r < row1; r += 4) {
+            const double *v = rows.data + r * rows.stride;
+            __m256d acc[4];
+#pragma GCC unroll 4
+            for (size_t j = 0; j < 4; j++) acc[j] = _mm256_setzero_pd();
+            for (size_t k = 0; k < len; k += 4) {
+                const __m256d x = _mm256_loadu_pd(q + k);
+#pragma GCC unroll 4
+                for (size_t j = 0; j < 4; j++)
+                    acc[j] = _mm256_fmadd_pd(x, _mm256_loadu_pd(v + j * rows.stride + k), acc[j]);
+            }
+            const __m256d s = reduce4_pd(acc[0], acc[1], acc[2], acc[3]);
+            if (sims) _mm256_storeu_pd(sims + p * sims_ld + rows.first + r, s);
+            const __m256d gt = _mm256_cmp_pd(s, best, _CMP_GT_OQ);
+            best = _mm256_blendv_pd(best, s, gt);
+            best_i = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(best_i), _mm256_castsi256_pd(idx), gt));
+            idx = _mm256_add_epi64(idx, _mm256_set1_epi64x(4));
+        }
+        _mm256_storeu_pd(lane_score + 4 * p, best);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lane_index + 4 * p), best_i);
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void tile_avx2(const RowView<float> &rows, size_t row0, size_t row1,
+                                                           const Matrix<float> &probes, float *lane_score,
+                                                           int32_t *lane_index, double *sims, size_t sims_ld) {
+    const size_t len = (rows.dim + 7) / 8 * 8;
+    for (size_t p = 0; p < probes.rows(); p++) {
+        const float *q = probes.row(p);
+        __m256 best = _mm256_loadu_ps(lane_score + 8 * p);
+        __m256i best_i = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lane_index + 8 * p));
+        __m256i idx = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(row0)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        for (size_t r = row0; r < row1; r += 8) {
+            const float *v = rows.data + r * rows.stride;
+            __m256 acc[8];
+#pragma GCC unroll 8
+            for (size_t j = 0; j < 8; j++) acc[j] = _mm256_setzero_ps();
+            for (size_t k = 0; k < len; k += 8) {
+                const __m256 x = _mm256_loadu_ps(q + k);
+#pragma GCC unroll 8
+                for (size_t j = 0; j < 8; j++)
+                    acc[j] = _mm256_fmadd_ps(x, _mm256_loadu_ps(v + j * rows.stride + k), acc[j]);
+            }
+            const __m256 s = reduce8_ps(acc);
+            if (sims) {
+                double *out = sims + p * sims_ld + rows.first + r;
+                _mm256_storeu_pd(out, _mm256_cvtps_pd(_mm256_castps256_ps128(s)));
+                _mm256_storeu_pd(out + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(s, 1)));
+            }
+            const __m256 gt = _mm256_cmp_ps(s, best, _CMP_GT_OQ);
+            best = _mm256_blendv_ps(best, s, gt);
+            best_i = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best_i), _mm256_castsi256_ps(idx), gt));
+            idx = _mm256_add_epi32(idx, _mm256_set1_epi32(8));
+        }
+        _mm256_storeu_ps(lane_score + 8 * p, best);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lane_index + 8 * p), best_i);
+    }
+}
+
+__attribute__((target("avx2,fma"))) static size_t normalize_avx2(double *data, size_t stride, size_t dim,
+                                                                size_t rows) {
+    const size_t len = (dim + 3) / 4 * 4;  // zero padding past dim
+    size_t zero = 0;
+    for (size_t r = 0; r < rows; r += 4) {
+        double *v = data + r * stride;
+        __m256d acc[4];
+#pragma GCC unroll 4
+        for (size_t j = 0; j < 4; j++) acc[j] = _mm256_setzero_pd();
+        for (size_t k = 0; k < len; k += 4) {
+#pragma GCC unroll 4
+            for (size_t j = 0; j < 4; j++) {
+                const __m256d x = _mm256_loadu_pd(v + j * stride + k);
+                acc[j] = _mm256_fmadd_pd(x, x, acc[j]);
+            }
+        }
+        const __m256d ss = reduce4_pd(acc[0], acc[1], acc[2], acc[3]);
+        // 1/sqrt(0) = inf: zero rows get scale 0 instead
+        const __m256d is_zero = _mm256_cmp_pd(ss, _mm256_setzero_pd(), _CMP_EQ_OQ);
+        const __m256d scale =
+            _mm256_andnot_pd(is_zero, _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sqrt_pd(ss)));
+        zero += static_cast<size_t>(__builtin_popcount(_mm256_movemask_pd(is_zero)));
+        alignas(32) double scales[4];
+        _mm256_store_pd(scales, scale);
+#pragma GCC unroll 4
+        for (size_t j = 0; j < 4; j++) {
+            const __m256d f = _mm256_set1_pd(scales[j]);
+            for (size_t k = 0; k < len; k += 4)
+                _mm256_storeu_pd(v + j * stride + k, _mm256_mul_pd(_mm256_loadu_pd(v + j * stride + k), f));
+        }
+    }
+    return zero;
+}
+
+__attribute__((target("avx2,fma"))) static size_t normalize_avx2(float *data, size_t stride, size_t dim,
+                                                                size_t rows) {
+    const size_t len = (dim + 7) / 8 * 8;
+    size_t zero = 0;
+    for (size_t r = 0; r < rows; r += 8) {
+        float *v = data + r * stride;
+        __m256 acc[8];
+#pragma GCC unroll 8
+        for (size_t j = 0; j < 8; j++) acc[j] = _mm256_setzero_ps();
+        for (size_t k = 0; k < len; k += 8) {
+#pragma GCC unroll 8
+            for (size_t j = 0; j < 8; j++) {
+                const __m256 x = _mm256_loadu_ps(v + j * stride + k);
+                acc[j] = _mm256_fmadd_ps(x, x, acc[j]);
+            }
+        }
+        const __m256 ss = reduce8_ps(acc);
+        // estimate + one Newton step: y * (1.5 - 0.5 * ss * y^2); zero rows get scale 0
+        const __m256 y = _mm256_rsqrt_ps(ss);
+        const __m256 half_ss_y = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), ss), y);
+        const __m256 refined = _mm256_mul_ps(y, _mm256_fnmadd_ps(half_ss_y, y, _mm256_set1_ps(1.5f)));
+        const __m256 is_zero = _mm256_cmp_ps(ss, _mm256_setzero_ps(), _CMP_EQ_OQ);
+        const __m256 scale = _mm256_andnot_ps(is_zero, refined);
+        zero += static_cast<size_t>(__builtin_popcount(_mm256_movemask_ps(is_zero)));
+        alignas(32) float scales[8];
+        _mm256_store_ps(scales, scale);
+#pragma GCC unroll 8
+        for (size_t j = 0; j < 8; j++) {
+            const __m256 f = _mm256_set1_ps(scales[j]);
+            for (size_t k = 0; k < len; k += 8)
+                _mm256_storeu_ps(v + j * stride + k, _mm256_mul_ps(_mm256_loadu_ps(v + j * stride + k), f));
+        }
+    }
+    return zero;
+}
+
+// GCC 12's AVX-512 headers seed intrinsic results with _mm512_undefined_*(), which
+// trips -Wmaybe-uninitialized once inlined (GCC PR 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+// [sum a[0], ..., sum a[7]]: pairwise sums within 128-bit lanes, then two rounds of
+// lane shuffles (0x88 picks lanes 0 and 2 of each input, 0xDD lanes 1 and 3).
+__attribute__((target("avx512f"))) static inline __m512d reduce8_pd(const __m512d *a) {
+    __m512d pairs[4];
+#pragma GCC unroll 4
+    for (size_t j = 0; j < 4; j++)
+        pairs[j] = _mm512_add_pd(_mm512_unpacklo_pd(a[2 * j], a[2 * j + 1]), _mm512_unpackhi_pd(a[2 * j], a[2 * j + 1]));
+    const __m512d q0 = _mm512_add_pd(_mm512_shuffle_f64x2(pairs[0], pairs[1], 0x88),
+                                     _mm512_shuffle_f64x2(pairs[0], pairs[1], 0xDD));
+    const __m512d q1 = _mm512_add_pd(_mm512_shuffle_f64x2(pairs[2], pairs[3], 0x88),
+                                     _mm512_shuffle_f64x2(pairs[2], pairs[3], 0xDD));
+    return _mm512_add_pd(_mm512_shuffle_f64x2(q0, q1, 0x88), _mm512_shuffle_f64x2(q0, q1, 0xDD));
+}
+
+// [sum a[0], ..., sum a[15]]: the same with one more in-lane step for 4 floats per lane.
+__attribute__((target("avx512f"))) static inline __m512 reduce16_ps(const __m512 *a) {
+    __m512 quads[4];
+#pragma GCC unroll 4
+    for (size_t j = 0; j < 4; j++) {
+        __m512 pair[2];
+#pragma GCC unroll 2
+        for (size_t h = 0; h < 2; h++) {
+            const __m512 x = a[4 * j + 2 * h], y = a[4 * j + 2 * h + 1];
+            pair[h] = _mm512_add_ps(_mm512_unpacklo_ps(x, y), _mm512_unpackhi_ps(x, y));
+        }
+        const __m512d p0 = _mm512_castps_pd(pair[0]), p1 = _mm512_castps_pd(pair[1]);
+        quads[j] = _mm512_add_ps(_mm512_castpd_ps(_mm512_unpacklo_pd(p0, p1)),
+                                 _mm512_castpd_ps(_mm512_unpackhi_pd(p0, p1)));
+    }
+    const __m512 q0 = _mm512_add_ps(_mm512_shuffle_f32x4(quads[0], quads[1], 0x88),
+                                    _mm512_shuffle_f32x4(quads[0], quads[1], 0xDD));
+    const __m512 q1 = _mm512_add_ps(_mm512_shuffle_f32x4(quads[2], quads[3], 0x88),
+                                    _mm512_shuffle_f32x4(quads[2], quads[3], 0xDD));
+    return _mm512_add_ps(_mm512_shuffle_f32x4(q0, q1, 0x88), _mm512_shuffle_f32x4(q0, q1, 0xDD));
+}
+
+__attribute__((target("avx512f"))) static void tile_avx512(const RowView<double> &rows, size_t row0,
+                                                                     size_t row1, const Matrix<double> &probes,
+                                                                     double *lane_score, int64_t *lane_index,
+                                                                     double *sims, size_t sims_ld) {
+    const size_t len = (rows.dim + 7) / 8 * 8;
+    for (size_t p = 0; p < probes.rows(); p++) {
+        const double *q = probes.row(p);
+        __m512d best = _mm512_loadu_pd(lane_score + 8 * p);
+        __m512i best_i = _mm512_loadu_si512(lane_index + 8 * p);
+        __m512i idx = _mm512_add_epi64(_mm512_set1_epi64(static_cast<long long>(row0)),
+                                       _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0));
+        for (size_t r = row0; r < row1; r += 8) {
+            const double *v = rows.data + r * rows.stride;
+            __m512d acc[8];
+#pragma GCC unroll 8
+            for (size_t j = 0; j < 8; j++) acc[j] = _mm512_setzero_pd();
+            for (size_t k = 0; k < len; k += 8) {
+                const __m512d x = _mm512_loadu_pd(q + k);
+#pragma GCC unroll 8
+                for (size_t j = 0; j < 8; j++)
+                    acc[j] = _mm512_fmadd_pd(x, _mm512_loadu_pd(v + j * rows.stride + k), acc[j]);
+            }
+            const __m512d s = reduce8_pd(acc);
+            if (sims) _mm512_storeu_pd(sims + p * sims_ld + rows.first + r, s);
+            const __mmask8 gt = _mm512_cmp_pd_mask(s, best, _CMP_GT_OQ);
+            best = _mm512_mask_blend_pd(gt, best, s);
+            best_i = _mm512_mask_blend_epi64(gt, best_i, idx);
+            idx = _mm512_add_epi64(idx, _mm512_set1_epi64(8));
+        }
+        _mm512_storeu_pd(lane_score + 8 * p, best);
+        _mm512_storeu_si512(lane_index + 8 * p, best_i);
+    }
+}
+
+__attribute__((target("avx512f"))) static void tile_avx512(const RowView<float> &rows, size_t row0,
+                                                                     size_t row1, const Matrix<float> &probes,
+                                                                     float *lane_score, int32_t *lane_index,
+                                                                     double *sims, size_t sims_ld) {
+    const size_t len = (rows.dim + 15) / 16 * 16;
+    for (size_t p = 0; p < probes.rows(); p++) {
+        const float *q = probes.row(p);
+        __m512 best = _mm512_loadu_ps(lane_score + 16 * p);
+        __m512i best_i = _mm512_loadu_si512(lane_index + 16 * p);
+        __m512i idx = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(row0)),
+                                       _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+        for (size_t r = row0; r < row1; r += 16) {
+            const float *v = rows.data + r * rows.stride;
+            __m512 acc[16];
+#pragma GCC unroll 16
+            for (size_t j = 0; j < 16; j++) acc[j] = _mm512_setzero_ps();
+            for (size_t k = 0; k < len; k += 16) {
+                const __m512 x = _mm512_loadu_ps(q + k);
+#pragma GCC unroll 16
+                for (size_t j = 0; j < 16; j++)
+                    acc[j] = _mm512_fmadd_ps(x, _mm512_loadu_ps(v + j * rows.stride + k), acc[j]);
+            }
+            const __m512 s = reduce16_ps(acc);
+            if (sims) {
+                alignas(64) float block[16];
+                _mm512_store_ps(block, s);
+                double *out = sims + p * sims_ld + rows.first + r;
+                _mm512_storeu_pd(out, _mm512_cvtps_pd(_mm256_load_ps(block)));
+                _mm512_storeu_pd(out + 8, _mm512_cvtps_pd(_mm256_load_ps(block + 8)));
+            }
+            const __mmask16 gt = _mm512_cmp_ps_mask(s, best, _CMP_GT_OQ);
+            best = _mm512_mask_blend_ps(gt, best, s);
+            best_i = _mm512_mask_blend_epi32(gt, best_i, idx);
+            idx = _mm512_add_epi32(idx, _mm512_set1_epi32(16));
+        }
+        _mm512_storeu_ps(lane_score + 16 * p, best);
+        _mm512_storeu_si512(lane_index + 16 * p, best_i);
+    }
+}
+
+__attribute__((target("avx512f"))) static size_t normalize_avx512(double *data, size_t stride, size_t dim,
+                                                                 size_t rows) {
+    const size_t len = (dim + 7) / 8 * 8;
+    size_t zero = 0;
+    for (size_t r = 0; r < rows; r += 8) {
+        double *v = data + r * stride;
+        __m512d acc[8];
+#pragma GCC unroll 8
+        for (size_t j = 0; j < 8; j++) acc[j] = _mm512_setzero_pd();
+        for (size_t k = 0; k < len; k += 8) {
+#pragma GCC unroll 8
+            for (size_t j = 0; j < 8; j++) {
+                const __m512d x = _mm512_loadu_pd(v + j * stride + k);
+                acc[j] = _mm512_fmadd_pd(x, x, acc[j]);
+            }
+        }
+        const __m512d ss = reduce8_pd(acc);
+        const __mmask8 is_zero = _mm512_cmp_pd_mask(ss, _mm512_setzero_pd(), _CMP_EQ_OQ);
+        const __m512d scale =
+            _mm512_maskz_div_pd(static_cast<__mmask8>(~is_zero), _mm512_set1_pd(1.0), _mm512_sqrt_pd(ss));
+        zero += static_cast<size_t>(__builtin_popcount(is_zero));
+        alignas(64) double scales[8];
+        _mm512_store_pd(scales, scale);
+#pragma GCC unroll 8
+        for (size_t j = 0; j < 8; j++) {
+            const __m512d f = _mm512_set1_pd(scales[j]);
+            for (size_t k = 0; k < len; k += 8)
+                _mm512_storeu_pd(v + j * stride + k, _mm512_mul_pd(_mm512_loadu_pd(v + j * stride + k), f));
+        }
+    }
+    return zero;
+}
+
+__attribute__((target("avx512f"))) static size_t normalize_avx512(float *data, size_t stride, size_t dim,
+                                                                 size_t rows) {
+    const size_t len = (dim + 15) / 16 * 16;
+    size_t zero = 0;
+    for (size_t r = 0; r < rows; r += 16) {
+        float *v = data + r * stride;
+        __m512 acc[16];
+#pragma GCC unroll 16
+        for (size_t j = 0; j < 16; j++) acc[j] = _mm512_setzero_ps();
+        for (size_t k = 0; k < len; k += 16) {
+#pragma GCC unroll 16
+            for (size_t j = 0; j < 16; j++) {
+                const __m512 x = _mm512_loadu_ps(v + j * stride + k);
+                acc[j] = _mm512_fmadd_ps(x, x, acc[j]);
+            }
+        }
+        const __m512 ss = reduce16_ps(acc);
+        const __mmask16 is_zero = _mm512_cmp_ps_mask(ss, _mm512_setzero_ps(), _CMP_EQ_OQ);
+        // 14-bit estimate + one Newton step; zero rows get scale 0
+        const __m512 y = _mm512_rsqrt14_ps(ss);
+        const __m512 half_ss_y = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), ss), y);
+        const __m512 scale = _mm512_maskz_mul_ps(static_cast<__mmask16>(~is_zero), y,
+                                                 _mm512_fnmadd_ps(half_ss_y, y, _mm512_set1_ps(1.5f)));
+        zero += static_cast<size_t>(__builtin_popcount(is_zero));
+        alignas(64) float scales[16];
+        _mm512_store_ps(scales, scale);
+#pragma GCC unroll 16
+        for (size_t j = 0; j < 16; j++) {
+            const __m512 f = _mm512_set1_ps(scales[j]);
+            for (size_t k = 0; k < len; k += 16)
+                _mm512_storeu_ps(v + j * stride + k, _mm512_mul_ps(_mm512_loadu_ps(v + j * stride + k), f));
+        }
+    }
+    return zero;
+}
+
+#pragma GCC diagnostic pop
+
+#endif  // KERNELS_X86
+
+static SimdLevel detect_simd_level() {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    // libgcc also checks that the OS saves the wider register state
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::Avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::Avx2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel simd_level() {
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+const char *simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Avx512: return "AVX-512";
+    case SimdLevel::Avx2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+static void check_level(const char *what, SimdLevel level) {
+    if (level > simd_level())
+        throw std::invalid_argument(std::string(what) + ": " + simd_level_name(level) + " is not supported by this CPU");
+}
+
+// Tiles the chunk's whole blocks through `kernel`, then reduces each probe's lanes and
+// the rows past the last whole block into best[p].
+template <class T>
+static void scan_chunk(const RowView<T> &rows, const Matrix<T> &probes, std::vector<BestMatch> &best, double *sims,
+                       size_t sims_ld, size_t lanes, TileKernel<T> kernel) {
+    const size_t probe_count = probes.rows();
+    const size_t blocked = rows.rows / lanes * lanes;
+    const size_t tile = std::max<size_t>(1, TILE_BYTES / (rows.stride * sizeof(T) * lanes)) * lanes;
+    std::vector<T> lane_score(probe_count * lanes, -std::numeric_limits<T>::infinity());
+    std::vector<LaneIndex<T>> lane_index(probe_count * lanes, 0);
+    for (size_t row0 = 0; row0 < blocked; row0 += tile)
+        kernel(rows, row0, std::min(row0 + tile, blocked), probes, lane_score.data(), lane_index.data(), sims, sims_ld);
+
+    for (size_t p = 0; p < probe_count; p++) {
+        // across lanes: highest score, ties to the lower row
+        T score = -std::numeric_limits<T>::infinity();
+        size_t row = 0;
+        for (size_t l = 0; l < lanes; l++) {
+            const T s = lane_score[p * lanes + l];
+            const size_t i = static_cast<size_t>(lane_index[p * lanes + l]);
+            if (s > score || (s == score && i < row)) {
+                score = s;
+                row = i;
+            }
+        }
+        // rows past the last whole block come after every lane's rows
+        for (size_t r = blocked; r < rows.rows; r++) {
+            const T s = dot(probes.row(p), rows.data + r * rows.stride, rows.dim);
+            if (sims) sims[p * sims_ld + rows.first + r] = s;
+            if (s > score) {
+                score = s;
+                row = r;
+            }
+        }
+        if (score > best[p].score) best[p] = BestMatch{score, rows.first + row};
+    }
+}
+
+template <class T>
+static size_t normalize_dispatch(Matrix<T> &m, size_t rows, SimdLevel level) {
+    if (m.order() != MatrixOrder::RowMajor) throw std::invalid_argument("normalize_rows: matrix is not row-major");
+    if (rows == static_cast<size_t>(-1)) rows = m.rows();
+    if (rows > m.rows()) throw std::invalid_argument("normalize_rows: more rows than the matrix has");
+    check_level("normalize_rows", level);
+    size_t lanes = 1;
+    NormalizeKernel<T> kernel = normalize_scalar<T>;
+#ifdef KERNELS_X86
+    if (level == SimdLevel::Avx512) {
+        lanes = 64 / sizeof(T);
+        kernel = normalize_avx512;
+    } else if (level == SimdLevel::Avx2) {
+        lanes = 32 / sizeof(T);
+        kernel = normalize_avx2;
+    }
+#endif
+    // whole blocks through the kernel, the rest one row at a time
+    const size_t blocked = rows / lanes * lanes;
+    size_t zero = kernel(m.data(), m.ld(), m.cols(), blocked);
+    if (blocked < rows) zero += normalize_scalar(m.row(blocked), m.ld(), m.cols(), rows - blocked);
+    return zero;
+}
+
+template <class T>
+static void check_scan(const RowView<T> &rows, const Matrix<T> &probes, const std::vector<BestMatch> &best,
+                       SimdLevel level) {
+    if (probes.order() != MatrixOrder::RowMajor || probes.cols() != rows.dim)
+        throw std::invalid_argument("scan_similarities: probes must be row-major with the rows' dimension");
+    if (best.size() != probes.rows()) throw std::invalid_argument("scan_similarities: one BestMatch per probe");
+    if (rows.stride < rows.dim || rows.stride % (Matrix<T>::ALIGNMENT / sizeof(T)) != 0)
+        throw std::invalid_argument("scan_similarities: rows are not laid out by a Matrix");
+    if (std::is_same<T, float>::value && rows.rows > static_cast<size_t>(INT32_MAX))
+        throw std::invalid_argument("scan_similarities: chunk too large for 32-bit row lanes");
+    check_level("scan_similarities", level);
+}
+
+template <class T>
+static void scan_dispatch(const RowView<T> &rows, const Matrix<T> &probes, std::vector<BestMatch> &best,
+                          double *sims, size_t sims_ld, SimdLevel level) {
+    check_scan(rows, probes, best, level);
+#ifdef KERNELS_X86
+    if (level == SimdLevel::Avx512) return scan_chunk<T>(rows, probes, best, sims, sims_ld, 64 / sizeof(T), tile_avx512);
+    if (level == SimdLevel::Avx2) return scan_chunk<T>(rows, probes, best, sims, sims_ld, 32 / sizeof(T), tile_avx2);
+#endif
+    scan_chunk<T>(rows, probes, best, sims, sims_ld, 1, tile_scalar<T>);
+}
+
+size_t normalize_rows(Matrix<float> &m, size_t rows, SimdLevel level) { return normalize_dispatch(m, rows, level); }
+
+size_t normalize_rows(Matrix<double> &m, size_t rows, SimdLevel level) { return normalize_dispatch(m, rows, level); }
+
+void scan_similarities(const RowView<float> &rows, const Matrix<float> &probes, std::vector<BestMatch> &best,
+                       double *sims, size_t sims_ld, SimdLevel level) {
+    scan_dispatch(rows, probes, best, sims, sims_ld, level);
+}
+
+void scan_similarities(const RowView<double> &rows, const Matrix<double> &probes, std::vector<BestMatch> &best,
+                       double *sims, size_t sims_ld, SimdLevel level) {
+    scan_dispatch(rows, probes, best, sims, sims_ld, level);
+}
@@ -0,0 +1,68 @@
+// kernels.h -- SIMD plaintext kernels (normalization, similarity scan) with runtime ISA dispatch
+//
+// normalize_rows brings every enrolled vector and every probe to unit L2 norm, a
+// block of rows at a time: the squares of the block's rows are summed in one pass
+// (fused multiply-add into one accumulator per row, reduced into a single register of
+// sums), the block gets its scale factors from one vector reciprocal square root, and
+// each row is then multiplied in place. All-zero rows are detected in the same
+// register and keep a scale of 0, so they stay zero instead of turning into NaN.
+//
+// The plaintext baseline scores every gallery row against every probe and keeps the
+// best match of each probe. It shadows the encrypted pipeline on every query, so it
+// has to keep up with the rate the loader streams rows in. scan_similarities is a
+// blocked GEMV over one chunk of rows:
+//   - the chunk is cut into tiles small enough to stay in cache while every probe
+//     runs over them, so the rows come from memory once per chunk, not once per probe
+//   - inside a tile, a block of rows (one score register: 4 / 8 doubles with AVX2 /
+//     AVX-512, 8 / 16 floats) is multiplied into one accumulator per row, and the
+//     block's dot products are reduced into a single register of scores
+//   - each probe's running max and argmax stay in registers, one lane per row of the
+//     block, for a whole tile and are reduced across lanes once per chunk
+// Rows and probes must come from a Matrix (matrix.h): its zero padding up to the
+// stride lets the kernels run over whole vectors without a remainder loop.
+//
+// Double rows get a correctly rounded 1/sqrt; float rows use the hardware estimate plus
+// one Newton step (within a few float ulps).
+//
+// The instruction set is picked at run time (__builtin_cpu_supports): AVX-512F, else
+// AVX2 + FMA, else a portable loop. Each path carries its own target attribute, so the
+// library is built without -mavx flags and runs on any x86-64 machine.
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "matrix.h"
+#include "rows.h"
+
+enum class SimdLevel { Scalar, Avx2, Avx512 };
+
+// Best level this CPU (and OS) supports; detected once.
+SimdLevel simd_level();
+const char *simd_level_name(SimdLevel level);
+
+// Scales rows [0, rows) (all rows by default) of a row-major matrix to unit L2 norm.
+// All-zero rows are left zero; returns how many there were. Throws
+// std::invalid_argument for a column-major matrix, more rows than it has, or a level
+// this CPU does not support.
+size_t normalize_rows(Matrix<float> &m, size_t rows = static_cast<size_t>(-1), SimdLevel level = simd_level());
+size_t normalize_rows(Matrix<double> &m, size_t rows = static_cast<size_t>(-1), SimdLevel level = simd_level());
+
+// Running best match of one probe.
+struct BestMatch {
+    double score = -std::numeric_limits<double>::infinity();
+    size_t index = 0;  // gallery index
+};
+
+// Scores every row of `rows` against every row of `probes` (same dim) and folds the
+// chunk into best[p] (ties keep the lower gallery index, as a sequential scan would).
+// If sims is non-null, score (p, i) is also written to sims[p * sims_ld + i] for every
+// gallery index i of the chunk. `level` may be forced down, e.g. to compare paths.
+// Throws std::invalid_argument on mismatched shapes, rows not laid out by a Matrix, or
+// a level this CPU does not support.
+void scan_similarities(const RowView<float> &rows, const Matrix<float> &probes, std::vector<BestMatch> &best,
+                       double *sims = nullptr, size_t sims_ld = 0, SimdLevel level = simd_level());
+void scan_similarities(const RowView<double> &rows, const Matrix<double> &probes, std::vector<BestMatch> &best,
+                       double *sims = nullptr, size_t sims_ld = 0, SimdLevel level = simd_level());
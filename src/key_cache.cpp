@@ -0,0 +1,112 @@
+// key_cache.cpp -- crypto context and evaluation-key cache on disk (see key_cache.h)
+
+#include "key_cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cryptocontext-ser.h"
+#include "key/key-ser.h"
+#include "scheme/ckksrns/ckksrns-ser.h"
+
+using namespace lbcrypto;
+
+static const char *CC_FILE = "cryptocontext.bin";
+static const char *PUBLIC_FILE = "key-public.bin";
+static const char *SECRET_FILE = "key-secret.bin";
+static const char *MULT_FILE = "key-eval-mult.bin";
+static const char *ROT_FILE = "key-eval-rot.bin";
+static const char *FINGERPRINT_FILE = "fingerprint.txt";
+
+static std::string in_dir(const std::string &dir, const char *file) {
+    return (std::filesystem::path(dir) / file).string();
+}
+
+// Replaces path with an empty file only the owner can read or write; the serializers then
+// truncate and fill it without touching the mode. O_EXCL refuses a file (or symlink)
+// planted between the remove and the open.
+static void create_private(const std::string &path) {
+    std::filesystem::remove(path);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) throw std::runtime_error("save_key_cache: cannot create " + path);
+    ::close(fd);
+}
+
+std::string key_fingerprint(const CircuitPlan &plan, const std::vector<int32_t> &rotations) {
+    std::ostringstream os;
+    os << "ckks depth=" << plan.mult_depth << " scale=" << plan.scale_bits << " first=" << plan.first_mod_bits
+       << " slots=" << plan.slots << " security=" << static_cast<int>(plan.request.security)
+       << " bootstrap=" << plan.bootstrapping;
+    if (plan.bootstrapping) {
+        os << " budget=";
+        for (uint32_t b : plan.bootstrap.level_budget) os << b << ",";
+    }
+    os << " rotations=";
+    for (int32_t r : rotations) os << r << ",";
+    return os.str();
+}
+
+bool load_key_cache(const std::string &dir, const std::string &fingerprint, CryptoContext<DCRTPoly> &cc,
+                    KeyPair<DCRTPoly> &kp) {
+    std::ifstream fp(in_dir(dir, FINGERPRINT_FILE));
+    std::string stored;
+    if (!fp || !std::getline(fp, stored) || stored != fingerprint) return false;
+
+    // drop contexts and keys from earlier generations so the loaded ones are the only match
+    CryptoContextImpl<DCRTPoly>::ClearEvalMultKeys();
+    CryptoContextImpl<DCRTPoly>::ClearEvalAutomorphismKeys();
+    CryptoContextFactory<DCRTPoly>::ReleaseAllContexts();
+
+    CryptoContext<DCRTPoly> loaded_cc;
+    KeyPair<DCRTPoly> loaded_kp;
+    if (!Serial::DeserializeFromFile(in_dir(dir, CC_FILE), loaded_cc, SerType::BINARY) ||
+        !Serial::DeserializeFromFile(in_dir(dir, PUBLIC_FILE), loaded_kp.publicKey, SerType::BINARY) ||
+        !Serial::DeserializeFromFile(in_dir(dir, SECRET_FILE), loaded_kp.secretKey, SerType::BINARY))
+        throw std::runtime_error("load_key_cache: cannot read context or keys from " + dir);
+
+    std::ifstream mult(in_dir(dir, MULT_FILE), std::ios::binary);
+    if (!mult || !loaded_cc->DeserializeEvalMultKey(mult, SerType::BINARY))
+        throw std::runtime_error("load_key_cache: cannot read relinearization keys from " + dir);
+    std::ifstream rot(in_dir(dir, ROT_FILE), std::ios::binary);
+    if (!rot || !loaded_cc->DeserializeEvalAutomorphismKey(rot, SerType::BINARY))
+        throw std::runtime_error("load_key_cache: cannot read rotation keys from " + dir);
+
+    cc = loaded_cc;
+    kp = loaded_kp;
+    return true;
+}
+
+void save_key_cache(const std::string &dir, const std::string &fingerprint, const CryptoContext<DCRTPoly> &cc,
+                    const KeyPair<DCRTPoly> &kp) {
+    // the directory holds the secret key: owner-only, also when it already existed
+    std::filesystem::create_directories(dir);
+    std::filesystem::permissions(dir, std::filesystem::perms::owner_all, std::filesystem::perm_options::replace);
+    // a stale fingerprint must not vouch for half-written files
+    std::filesystem::remove(in_dir(dir, FINGERPRINT_FILE));
+    for (const char *file : {CC_FILE, PUBLIC_FILE, SECRET_FILE, MULT_FILE, ROT_FILE}) create_private(in_dir(dir, file));
+
+    if (!Serial::SerializeToFile(in_dir(dir, CC_FILE), cc, SerType::BINARY) ||
+        !Serial::SerializeToFile(in_dir(dir, PUBLIC_FILE), kp.publicKey, SerType::BINARY) ||
+        !Serial::SerializeToFile(in_dir(dir, SECRET_FILE), kp.secretKey, SerType::BINARY))
+        throw std::runtime_error("save_key_cache: cannot write context or keys to " + dir);
+
+    const std::string tag = kp.secretKey->GetKeyTag();
+    std::ofstream mult(in_dir(dir, MULT_FILE), std::ios::binary | std::ios::trunc);
+    if (!mult || !cc->SerializeEvalMultKey(mult, SerType::BINARY, tag))
+        throw std::runtime_error("save_key_cache: cannot write relinearization keys to " + dir);
+    std::ofstream rot(in_dir(dir, ROT_FILE), std::ios::binary | std::ios::trunc);
+    if (!rot || !cc->SerializeEvalAutomorphismKey(rot, SerType::BINARY, tag))
+        throw std::runtime_error("save_key_cache: cannot write rotation keys to " + dir);
+    mult.close();
+    rot.close();
+    if (!mult || !rot) throw std::runtime_error("save_key_cache: failed writing eval keys to " + dir);
+
+    std::ofstream fp(in_dir(dir, FINGERPRINT_FILE), std::ios::trunc);
+    fp << fingerprint << "\n";
+    if (!fp) throw std::runtime_error("save_key_cache: cannot write fingerprint to " + dir);
+}
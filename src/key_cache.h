@@ -0,0 +1,46 @@
+// key_cache.h -- crypto context and evaluation-key cache on disk
+//
+// Context generation and KeyGen / EvalMultKeyGen / EvalAtIndexKeyGen / EvalBootstrapKeyGen
+// dominate cold start at larger ring dimensions. The cache directory holds everything
+// they produce, in OpenFHE binary serialization:
+//
+//     cryptocontext.bin   context (parameters and enabled features)
+//     key-public.bin      public key
+//     key-secret.bin      secret key (demo only: a real server never holds it)
+//     key-eval-mult.bin   relinearization keys       (SerializeEvalMultKey)
+//     key-eval-rot.bin    rotation/automorphism keys (SerializeEvalAutomorphismKey,
+//                         includes the bootstrapping keys)
+//     fingerprint.txt     key_fingerprint() the files were generated for, written last
+//
+// Because of the secret key, the directory is made owner-only (0700) and every file is
+// created 0600 before any key material is written to it.
+//
+// The cache is reused only when the stored fingerprint equals the current one, so any
+// change to the planned parameters or the rotation set regenerates it. Bootstrapping
+// precomputations are not part of the serialized state: call setup_bootstrapping()
+// again after a load.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "openfhe/pke/openfhe.h"
+#include "planner.h"
+
+// Everything the generated keys depend on: context parameters, bootstrapping setup
+// and the rotation index set.
+std::string key_fingerprint(const CircuitPlan &plan, const std::vector<int32_t> &rotations);
+
+// Loads context and keys from `dir` if it holds a complete cache for `fingerprint`.
+// Returns false (leaving cc / kp untouched) on a missing or mismatching cache, and
+// throws std::runtime_error if a matching cache turns out to be unreadable.
+bool load_key_cache(const std::string &dir, const std::string &fingerprint,
+                    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc, lbcrypto::KeyPair<lbcrypto::DCRTPoly> &kp);
+
+// Writes context, key pair and every eval key registered for kp's tag to `dir`
+// (created if needed). Throws std::runtime_error on I/O failure.
+void save_key_cache(const std::string &dir, const std::string &fingerprint,
+                    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                    const lbcrypto::KeyPair<lbcrypto::DCRTPoly> &kp);
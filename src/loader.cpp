@@ -0,0 +1,188 @@
+// loader.cpp -- streaming gallery loader (see loader.h)
+
+#include "loader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static bool ends_with(const std::string &s, const std::string &suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+VectorFormat vector_format_for(const std::string &path) {
+    if (ends_with(path, ".fvecs")) return VectorFormat::Fvecs;
+    if (ends_with(path, ".npy")) return VectorFormat::Npy;
+    return VectorFormat::RawF32;
+}
+
+// Value of `key` in the Python dict literal of an .npy header, up to the next ',' or
+// '}' at nesting depth 0 (so a shape tuple comes back whole).
+static std::string npy_field(const std::string &header, const std::string &key) {
+    size_t pos = header.find("'" + key + "'");
+    if (pos == std::string::npos) throw std::runtime_error("VectorFile: .npy header has no " + key);
+    pos = header.find(':', pos);
+    if (pos == std::string::npos) throw std::runtime_error("VectorFile: malformed .npy header");
+    size_t end = pos + 1;
+    int depth = 0;
+    for (; end < header.size(); end++) {
+        char c = header[end];
+        if (c == '(') depth++;
+        if (c == ')') depth--;
+        if (depth == 0 && (c == ',' || c == '}')) break;
+    }
+    std::string value = header.substr(pos + 1, end - pos - 1);
+    const size_t b = value.find_first_not_of(" \t");
+    const size_t e = value.find_last_not_of(" \t");
+    return b == std::string::npos ? "" : value.substr(b, e - b + 1);
+}
+
+VectorFile::VectorFile(const std::string &path, size_t raw_dim) : format_(vector_format_for(path)) {
+    if (format_ == VectorFormat::RawF32 && raw_dim == 0)
+        throw std::invalid_argument("VectorFile: raw float32 file " + path + " needs a dimension");
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("VectorFile: cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("VectorFile: cannot stat " + path + " (or it is empty)");
+    }
+    length_ = static_cast<size_t>(st.st_size);
+    fingerprint_ = std::filesystem::absolute(path).lexically_normal().string() + " size=" + std::to_string(length_) +
+                   " mtime=" + std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec);
+    void *m = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // the mapping keeps the file alive
+    if (m == MAP_FAILED) throw std::runtime_error("VectorFile: cannot mmap " + path);
+    data_ = static_cast<const char *>(m);
+    ::madvise(m, length_, MADV_SEQUENTIAL);
+
+    try {
+        if (format_ == VectorFormat::Fvecs) {
+            int32_t d;
+            if (length_ < sizeof(d)) throw std::runtime_error("VectorFile: truncated " + path);
+            std::memcpy(&d, data_, sizeof(d));
+            if (d <= 0) throw std::runtime_error("VectorFile: bad dimension in " + path);
+            dim_ = static_cast<size_t>(d);
+            prefix_bytes_ = sizeof(int32_t);
+            offset_ = 0;
+        } else if (format_ == VectorFormat::Npy) {
+            static const char MAGIC[] = "\x93NUMPY";
+            if (length_ < 10 || std::memcmp(data_, MAGIC, 6) != 0)
+                throw std::runtime_error("VectorFile: " + path + " is not an .npy file");
+            const uint8_t major = static_cast<uint8_t>(data_[6]);
+            size_t header_len;
+            if (major == 1) {
+                uint16_t n;
+                std::memcpy(&n, data_ + 8, sizeof(n));
+                header_len = n;
+                offset_ = 10 + header_len;
+            } else {
+                uint32_t n;
+                if (length_ < 12) throw std::runtime_error("VectorFile: truncated " + path);
+                std::memcpy(&n, data_ + 8, sizeof(n));
+                header_len = n;
+                offset_ = 12 + header_len;
+            }
+            if (offset_ > length_) throw std::runtime_error("VectorFile: truncated " + path);
+            const std::string header(data_ + offset_ - header_len, header_len);
+            const std::string descr = npy_field(header, "descr");
+            if (descr == "'<f4'") value_bytes_ = 4;
+            else if (descr == "'<f8'") value_bytes_ = 8;
+            else throw std::runtime_error("VectorFile: unsupported .npy dtype " + descr + " (need <f4 or <f8)");
+            if (npy_field(header, "fortran_order") != "False")
+                throw std::runtime_error("VectorFile: .npy gallery must be C order");
+            const std::string shape = npy_field(header, "shape");
+            size_t rows = 0, cols = 0;
+            if (std::sscanf(shape.c_str(), "(%zu, %zu)", &rows, &cols) != 2 || cols == 0)
+                throw std::runtime_error("VectorFile: .npy gallery must be 2-D, got shape " + shape);
+            dim_ = cols;
+            count_ = rows;
+        } else {
+            dim_ = raw_dim;
+            offset_ = 0;
+        }
+        row_bytes_ = prefix_bytes_ + dim_ * value_bytes_;
+        const size_t body = length_ - offset_;
+        if (format_ != VectorFormat::Npy) {
+            if (body % row_bytes_ != 0)
+                throw std::runtime_error("VectorFile: " + path + " is not a whole number of " +
+                                         std::to_string(dim_) + "-D rows");
+            count_ = body / row_bytes_;
+        } else if (count_ > body / row_bytes_) {
+            throw std::runtime_error("VectorFile: truncated " + path);
+        }
+    } catch (...) {
+        ::munmap(const_cast<char *>(data_), length_);
+        throw;
+    }
+}
+
+VectorFile::~VectorFile() {
+    if (data_) ::munmap(const_cast<char *>(data_), length_);
+}
+
+// Copies rows [first, first + n) into out as T; stored values are float32 or float64.
+template <class T>
+void VectorFile::read_rows(size_t first, size_t n, Matrix<T> &out) const {
+    if (first > count_ || n > count_ - first) throw std::out_of_range("VectorFile::read_normalized: past the end");
+    if (out.order() != MatrixOrder::RowMajor || out.cols() != dim_ || out.rows() < n)
+        throw std::invalid_argument("VectorFile::read_normalized: output is not a row-major matrix of " +
+                                    std::to_string(n) + " x " + std::to_string(dim_));
+    for (size_t r = 0; r < n; r++) {
+        const char *row = data_ + offset_ + (first + r) * row_bytes_;
+        if (prefix_bytes_) {
+            int32_t d;
+            std::memcpy(&d, row, sizeof(d));
+            if (static_cast<size_t>(d) != dim_)
+                throw std::runtime_error("VectorFile: row " + std::to_string(first + r) + " has dimension " +
+                                         std::to_string(d) + ", expected " + std::to_string(dim_));
+        }
+        const char *values = row + prefix_bytes_;
+        T *dst = out.row(r);
+        if (value_bytes_ == sizeof(T)) {
+            std::memcpy(dst, values, dim_ * sizeof(T));
+        } else if (value_bytes_ == 4) {
+            // the mapping gives no alignment guarantee for the values
+            const float *src = reinterpret_cast<const float *>(values);
+            if (reinterpret_cast<uintptr_t>(src) % alignof(float) == 0) {
+#pragma omp simd
+                for (size_t k = 0; k < dim_; k++) dst[k] = src[k];
+            } else {
+                for (size_t k = 0; k < dim_; k++) {
+                    float f;
+                    std::memcpy(&f, values + k * sizeof(f), sizeof(f));
+                    dst[k] = f;
+                }
+            }
+        } else {
+            for (size_t k = 0; k < dim_; k++) {
+                double d;
+                std::memcpy(&d, values + k * sizeof(d), sizeof(d));
+                dst[k] = static_cast<T>(d);
+            }
+        }
+    }
+
+    // drop the pages the chunk came from; a later read of the same rows faults them back in
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t begin = offset_ + first * row_bytes_, end = offset_ + (first + n) * row_bytes_;
+    const size_t lo = (begin + page - 1) / page * page, hi = end / page * page;
+    if (hi > lo) ::madvise(const_cast<char *>(data_) + lo, hi - lo, MADV_DONTNEED);
+}
+
+size_t VectorFile::read_normalized(size_t first, size_t n, Matrix<float> &out) const {
+    read_rows(first, n, out);
+    return normalize_rows(out, n);
+}
+
+size_t VectorFile::read_normalized(size_t first, size_t n, Matrix<double> &out) const {
+    read_rows(first, n, out);
+    return normalize_rows(out, n);
+}
@@ -0,0 +1,68 @@
+// loader.h -- streaming gallery loader for .fvecs, .npy and raw float32 files
+//
+// A VectorFile mmaps the gallery and reads only its header up front. Rows are then
+// copied out in chunks as normalized float or double rows (read_normalized), straight
+// into the caller's chunk Matrix (matrix.h); the mapped pages a chunk came from are
+// dropped right after, so resident memory stays at one chunk no matter how large the
+// file is.
+//
+// Formats (little-endian):
+//   .fvecs  every row is an int32 dimension followed by that many float32 values
+//   .npy    NumPy format 1.0-3.0, dtype <f4 or <f8, C order, shape (count, dim)
+//   other   raw float32, row-major; the dimension must be given
+//
+// All rows must have the same dimension.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "kernels.h"
+#include "matrix.h"
+
+enum class VectorFormat { Fvecs, Npy, RawF32 };
+
+// By extension: .fvecs, .npy, anything else is raw float32.
+VectorFormat vector_format_for(const std::string &path);
+
+class VectorFile {
+public:
+    // mmaps `path` and parses its header. raw_dim is the row dimension of a raw float32
+    // file (ignored for the self-describing formats). Throws std::runtime_error if the
+    // file cannot be mapped or is malformed, std::invalid_argument on a missing raw_dim.
+    explicit VectorFile(const std::string &path, size_t raw_dim = 0);
+    ~VectorFile();
+    VectorFile(const VectorFile &) = delete;
+    VectorFile &operator=(const VectorFile &) = delete;
+
+    VectorFormat format() const { return format_; }
+    size_t count() const { return count_; }
+    size_t dim() const { return dim_; }
+    // Identifies the file's contents for caches built from it (store.h): absolute path,
+    // size and modification time, so replacing or editing the file changes it.
+    const std::string &fingerprint() const { return fingerprint_; }
+
+    // Rows [first, first + n), normalize_rows()'d, into the first n rows of `out` (row-major,
+    // dim() columns, at least n rows). Returns the number of all-zero rows (left zero).
+    // Throws std::out_of_range past count(), std::invalid_argument on a mismatched `out`,
+    // std::runtime_error on a ragged .fvecs row.
+    size_t read_normalized(size_t first, size_t n, Matrix<float> &out) const;
+    size_t read_normalized(size_t first, size_t n, Matrix<double> &out) const;
+
+private:
+    template <class T>
+    void read_rows(size_t first, size_t n, Matrix<T> &out) const;
+
+    const char *data_ = nullptr;
+    size_t length_ = 0;
+    VectorFormat format_ = VectorFormat::RawF32;
+    size_t count_ = 0;
+    size_t dim_ = 0;
+    size_t offset_ = 0;       // first row
+    size_t row_bytes_ = 0;    // distance between rows
+    size_t value_bytes_ = 4;  // 4 (float32) or 8 (float64, .npy only)
+    size_t prefix_bytes_ = 0; // per-row dimension prefix (.fvecs)
+    std::string fingerprint_;
+};
@@ -0,0 +1,89 @@
+// matrix.h -- contiguous, 64-byte aligned dense matrix for the plaintext stages
+//
+// One allocation per matrix, row-major or column-major. The leading dimension ld()
+// (distance between consecutive rows, or columns in column-major order) is padded
+// to a multiple of 64 bytes, so every row starts on a cache line and a SIMD load of
+// a row never splits one. The padding is zeroed at allocation and must stay zero:
+// kernels may run over ld() values instead of cols() without a remainder loop.
+//
+// The loader reads gallery chunks into a Matrix, normalization and the plaintext
+// baseline (kernels.h) work on it in place, and RowBlock (rows.h) views its rows for
+// the encoders without copying them.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+enum class MatrixOrder { RowMajor, ColMajor };
+
+template <class T>
+class Matrix {
+    static_assert(std::is_same<T, float>::value || std::is_same<T, double>::value, "Matrix holds float or double");
+
+public:
+    static constexpr size_t ALIGNMENT = 64;  // bytes
+
+    Matrix() = default;
+    // rows x cols zeros. Throws std::bad_alloc.
+    Matrix(size_t rows, size_t cols, MatrixOrder order = MatrixOrder::RowMajor)
+        : rows_(rows), cols_(cols), order_(order), ld_(padded(order == MatrixOrder::RowMajor ? cols : rows)) {
+        const size_t bytes = ld_ * (order == MatrixOrder::RowMajor ? rows : cols) * sizeof(T);
+        if (bytes == 0) return;
+        void *p = std::aligned_alloc(ALIGNMENT, bytes);  // bytes is a multiple of ALIGNMENT
+        if (!p) throw std::bad_alloc();
+        std::memset(p, 0, bytes);
+        data_.reset(static_cast<T *>(p));
+    }
+    Matrix(Matrix &&) = default;
+    Matrix &operator=(Matrix &&) = default;
+    Matrix(const Matrix &) = delete;
+    Matrix &operator=(const Matrix &) = delete;
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    MatrixOrder order() const { return order_; }
+    size_t ld() const { return ld_; }
+
+    T *data() { return data_.get(); }
+    const T *data() const { return data_.get(); }
+
+    T &operator()(size_t i, size_t j) { return data_.get()[offset(i, j)]; }
+    const T &operator()(size_t i, size_t j) const { return data_.get()[offset(i, j)]; }
+
+    // Row i of a row-major matrix (cols() values, 64-byte aligned).
+    T *row(size_t i) { return data_.get() + i * ld_; }
+    const T *row(size_t i) const { return data_.get() + i * ld_; }
+    // Column j of a column-major matrix (rows() values, 64-byte aligned).
+    T *col(size_t j) { return data_.get() + j * ld_; }
+    const T *col(size_t j) const { return data_.get() + j * ld_; }
+
+    // The same values in `order`, e.g. column-major for per-dimension passes.
+    Matrix with_order(MatrixOrder order) const {
+        Matrix out(rows_, cols_, order);
+        for (size_t i = 0; i < rows_; i++)
+            for (size_t j = 0; j < cols_; j++) out(i, j) = (*this)(i, j);
+        return out;
+    }
+
+private:
+    struct Free {
+        void operator()(T *p) const { std::free(p); }
+    };
+
+    static size_t padded(size_t n) {
+        const size_t per_line = ALIGNMENT / sizeof(T);
+        return (n + per_line - 1) / per_line * per_line;
+    }
+    size_t offset(size_t i, size_t j) const { return order_ == MatrixOrder::RowMajor ? i * ld_ + j : j * ld_ + i; }
+
+    std::unique_ptr<T, Free> data_;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    MatrixOrder order_ = MatrixOrder::RowMajor;
+    size_t ld_ = 0;
+};
@@ -0,0 +1,232 @@
+// matvec.cpp -- diagonal BSGS matrix-vector engine (see matvec.h)
+
+#include "matvec.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "parallel.h"
+#include "rotation.h"
+
+using namespace lbcrypto;
+
+static bool is_power_of_two(size_t x) { return x != 0 && (x & (x - 1)) == 0; }
+
+DiagonalLayout make_diagonal_layout(size_t count, size_t dim, size_t slots, RotationKeyMode keys) {
+    if (!is_power_of_two(dim))
+        throw std::invalid_argument("diagonal layout: dim must be a power of two");
+    if (dim > slots)
+        throw std::invalid_argument("diagonal layout: dim exceeds slot count");
+    DiagonalLayout layout;
+    layout.count = count;
+    layout.dim = dim;
+    layout.slots = slots;
+    // smallest power of two >= sqrt(dim): minimizes baby + giant rotations
+    layout.baby = 1;
+    while (layout.baby * layout.baby < dim) layout.baby <<= 1;
+    layout.giant = dim / layout.baby;
+    layout.keys = keys;
+    return layout;
+}
+
+std::vector<double> diagonal_slots(const RowBlock &rows, const DiagonalLayout &layout, size_t block, size_t k,
+                                   size_t b) {
+    const size_t j = k * layout.baby + b;
+    const size_t shift = k * layout.baby;  // pre-rotation by -shift
+    const size_t first = block * layout.slots;
+    std::vector<double> out(layout.slots, 0.0);
+    for (size_t i = 0; i < layout.slots; i++) {
+        // out[i] = D_j[(i - shift) mod slots]
+        size_t src = (i + layout.slots - shift) % layout.slots;
+        size_t row = first + src;
+        if (row >= layout.count) continue;
+        out[i] = rows.row(row)[(src + j) % layout.dim];
+    }
+    return out;
+}
+
+std::vector<double> tile_query(const double *query, const DiagonalLayout &layout) {
+    std::vector<double> out(layout.slots);
+    for (size_t i = 0; i < layout.slots; i++) out[i] = query[i % layout.dim];
+    return out;
+}
+
+std::vector<int32_t> matvec_rotations(const DiagonalLayout &layout) {
+    std::vector<int32_t> idx;
+    if (layout.keys == RotationKeyMode::Minimal) {
+        if (layout.baby > 1) idx.push_back(1);
+        if (layout.giant > 1) idx.push_back(static_cast<int32_t>(layout.baby));
+        return idx;
+    }
+    for (size_t b = 1; b < layout.baby; b++) idx.push_back(static_cast<int32_t>(b));
+    for (size_t k = 1; k < layout.giant; k++) idx.push_back(static_cast<int32_t>(k * layout.baby));
+    return idx;
+}
+
+std::pair<size_t, size_t> diagonal_block_range(const RowBlock &rows, const DiagonalLayout &layout) {
+    if (rows.dim != layout.dim) throw std::invalid_argument("diagonal_block_range: row dimension differs from layout");
+    if (rows.first % layout.slots != 0 || (rows.end() % layout.slots != 0 && rows.end() != layout.count) ||
+        rows.end() > layout.count)
+        throw std::invalid_argument("diagonal_block_range: rows do not cover whole row blocks");
+    return {rows.first / layout.slots, (rows.end() + layout.slots - 1) / layout.slots};
+}
+
+std::vector<Plaintext> encode_diagonals(const CryptoContext<DCRTPoly> &cc, const RowBlock &rows,
+                                        const DiagonalLayout &layout, uint32_t level) {
+    const auto range = diagonal_block_range(rows, layout);
+    // flat index t = (block * giant + k) * baby + b, relative to the first covered block;
+    // every task writes only its own entry
+    std::vector<Plaintext> out((range.second - range.first) * layout.dim);
+    parallel_for(out.size(), [&](size_t t) {
+        size_t blk = range.first + t / layout.dim, k = (t % layout.dim) / layout.baby, b = t % layout.baby;
+        out[t] = cc->MakeCKKSPackedPlaintext(diagonal_slots(rows, layout, blk, k, b), 1, level);
+    });
+    return out;
+}
+
+std::vector<Ciphertext<DCRTPoly>> encrypt_diagonals(const CryptoContext<DCRTPoly> &cc,
+                                                    const PublicKey<DCRTPoly> &pk, const RowBlock &rows,
+                                                    const DiagonalLayout &layout) {
+    const auto range = diagonal_block_range(rows, layout);
+    std::vector<Ciphertext<DCRTPoly>> out((range.second - range.first) * layout.dim);
+    parallel_for(out.size(), [&](size_t t) {
+        size_t blk = range.first + t / layout.dim, k = (t % layout.dim) / layout.baby, b = t % layout.baby;
+        out[t] = cc->Encrypt(pk, cc->MakeCKKSPackedPlaintext(diagonal_slots(rows, layout, blk, k, b)));
+    });
+    return out;
+}
+
+std::vector<Ciphertext<DCRTPoly>> baby_steps(const CryptoContext<DCRTPoly> &cc,
+                                             const Ciphertext<DCRTPoly> &enc_query_tiled,
+                                             const DiagonalLayout &layout) {
+    if (layout.keys == RotationKeyMode::Minimal) {
+        std::vector<Ciphertext<DCRTPoly>> out{enc_query_tiled};
+        for (size_t b = 1; b < layout.baby; b++) out.push_back(cc->EvalAtIndex(out.back(), 1));
+        return out;
+    }
+    // every baby step rotates the same ciphertext: one shared decomposition
+    std::vector<int32_t> idx(layout.baby);
+    for (size_t b = 0; b < layout.baby; b++) idx[b] = static_cast<int32_t>(b);
+    return hoisted_rotations(cc, enc_query_tiled, idx);
+}
+
+// Padding rows of the last block: SCORE_FLOOR, real rows: 0.
+static std::vector<double> block_floor(const DiagonalLayout &layout, size_t block) {
+    std::vector<double> floor(layout.slots, 0.0);
+    for (size_t i = 0; i < layout.slots; i++)
+        if (block * layout.slots + i >= layout.count) floor[i] = SCORE_FLOOR;
+    return floor;
+}
+
+// sum_b rot(D_{k*baby+b}, -k*baby) * rot(q, b): giant step k of block blk, not yet rotated.
+// Works for every diagonal source: EvalMult has ct x pt and ct x ct overloads.
+template <class Matrix>
+static Ciphertext<DCRTPoly> giant_step(const CryptoContext<DCRTPoly> &cc,
+                                       const std::vector<Ciphertext<DCRTPoly>> &baby, const Matrix &m,
+                                       size_t blk, size_t k) {
+    Ciphertext<DCRTPoly> inner = cc->EvalMult(baby[0], m.at(blk, k, 0));
+    for (size_t b = 1; b < m.layout.baby; b++)
+        cc->EvalAddInPlace(inner, cc->EvalMult(baby[b], m.at(blk, k, b)));
+    return inner;
+}
+
+static std::vector<EncryptedScores> make_scores(const DiagonalLayout &layout, size_t queries) {
+    std::vector<EncryptedScores> out(queries);
+    for (auto &scores : out) {
+        scores.count = layout.count;
+        scores.per_ct = layout.slots;
+        scores.stride = 1;
+        scores.cts.resize(layout.num_blocks());
+    }
+    return out;
+}
+
+static void add_block_floor(const CryptoContext<DCRTPoly> &cc, const DiagonalLayout &layout, size_t blk,
+                            Ciphertext<DCRTPoly> &acc) {
+    if ((blk + 1) * layout.slots > layout.count)
+        cc->EvalAddInPlace(acc, cc->MakeCKKSPackedPlaintext(block_floor(layout, blk)));
+}
+
+// Minimal key set: M q = in_0 + rot(in_1 + rot(in_2 + ..., baby), baby), one rotation key.
+template <class Matrix>
+static std::vector<EncryptedScores> matvec_horner(const CryptoContext<DCRTPoly> &cc,
+                                                  const std::vector<std::vector<Ciphertext<DCRTPoly>>> &babies,
+                                                  const Matrix &m, WorkStealingPool *pool) {
+    const DiagonalLayout &layout = m.layout;
+    const size_t blocks = layout.num_blocks(), shards = blocks * layout.giant;
+    // inner[q * shards + t]; each shard fetches its diagonals once for every query
+    std::vector<Ciphertext<DCRTPoly>> inner(babies.size() * shards);
+    WorkStealingPool::run_on(pool, shards, [&](size_t t, size_t) {
+        for (size_t q = 0; q < babies.size(); q++)
+            inner[q * shards + t] = giant_step(cc, babies[q], m, t / layout.giant, t % layout.giant);
+    });
+    std::vector<EncryptedScores> out = make_scores(layout, babies.size());
+    WorkStealingPool::run_on(pool, babies.size() * blocks, [&](size_t t, size_t) {
+        size_t q = t / blocks, blk = t % blocks;
+        const Ciphertext<DCRTPoly> *in = &inner[q * shards + blk * layout.giant];
+        Ciphertext<DCRTPoly> acc = in[layout.giant - 1];
+        for (size_t k = layout.giant - 1; k-- > 0;)
+            acc = cc->EvalAdd(cc->EvalAtIndex(acc, static_cast<int32_t>(layout.baby)), in[k]);
+        add_block_floor(cc, layout, blk, acc);
+        out[q].cts[blk] = acc;
+    });
+    return out;
+}
+
+template <class Matrix>
+static std::vector<EncryptedScores> matvec_impl(const CryptoContext<DCRTPoly> &cc,
+                                                const std::vector<std::vector<Ciphertext<DCRTPoly>>> &babies,
+                                                const Matrix &m, WorkStealingPool *pool) {
+    const DiagonalLayout &layout = m.layout;
+    const size_t blocks = layout.num_blocks();
+    if (layout.keys == RotationKeyMode::Minimal) return matvec_horner(cc, babies, m, pool);
+    // partial[worker][q * blocks + block]: only ever touched by its own worker
+    std::vector<std::vector<Ciphertext<DCRTPoly>>> partial(
+        WorkStealingPool::workers(pool), std::vector<Ciphertext<DCRTPoly>>(babies.size() * blocks));
+    WorkStealingPool::run_on(pool, blocks * layout.giant, [&](size_t t, size_t worker) {
+        size_t blk = t / layout.giant, k = t % layout.giant;
+        for (size_t q = 0; q < babies.size(); q++) {
+            Ciphertext<DCRTPoly> inner = giant_step(cc, babies[q], m, blk, k);
+            if (k > 0) inner = cc->EvalAtIndex(inner, static_cast<int32_t>(k * layout.baby));
+            Ciphertext<DCRTPoly> &acc = partial[worker][q * blocks + blk];
+            if (acc) cc->EvalAddInPlace(acc, inner);
+            else acc = inner;
+        }
+    });
+
+    std::vector<EncryptedScores> out = make_scores(layout, babies.size());
+    for (size_t q = 0; q < babies.size(); q++) {
+        for (size_t blk = 0; blk < blocks; blk++) {
+            Ciphertext<DCRTPoly> acc;
+            for (auto &per_worker : partial) {
+                const Ciphertext<DCRTPoly> &part = per_worker[q * blocks + blk];
+                if (!part) continue;
+                if (acc) cc->EvalAddInPlace(acc, part);
+                else acc = part;
+            }
+            add_block_floor(cc, layout, blk, acc);
+            out[q].cts[blk] = acc;
+        }
+    }
+    return out;
+}
+
+std::vector<EncryptedScores> matvec_batch_similarities(
+    const CryptoContext<DCRTPoly> &cc, const std::vector<std::vector<Ciphertext<DCRTPoly>>> &babies,
+    const PlainMatrix &m, WorkStealingPool *pool) {
+    return matvec_impl(cc, babies, m, pool);
+}
+
+std::vector<EncryptedScores> matvec_batch_similarities(
+    const CryptoContext<DCRTPoly> &cc, const std::vector<std::vector<Ciphertext<DCRTPoly>>> &babies,
+    const EncryptedMatrix &m, WorkStealingPool *pool) {
+    return matvec_impl(cc, babies, m, pool);
+}
+
+std::vector<EncryptedScores> matvec_batch_similarities(
+    const CryptoContext<DCRTPoly> &cc, const std::vector<std::vector<Ciphertext<DCRTPoly>>> &babies,
+    const StoredMatrix &m, WorkStealingPool *pool) {
+    if (m.store->size() != m.layout.num_blocks() * m.layout.dim)
+        throw std::invalid_argument("matvec_batch_similarities: store does not hold this layout's diagonals");
+    return matvec_impl(cc, babies, m, pool);
+}
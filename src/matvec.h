@@ -0,0 +1,126 @@
+// matvec.h -- Halevi-Shoup diagonal matrix-vector engine with baby-step/giant-step rotations
+//
+// The DB is treated as a (count x dim) matrix M, cut into row blocks of `slots` rows.
+// With the query tiled across all slots, the generalized diagonals
+//     D_j[i] = M[block*slots + i][(i + j) % dim],   j = 0 .. dim-1
+// give  sum_j D_j * rot(q, j) = M q  for every row of the block at once, so each
+// output ciphertext holds cos(q, v_i) in slot i.
+//
+// BSGS: write j = k*baby + b. Rotating each diagonal by -k*baby at encode time lets
+// the rotations of q be shared ("baby steps", computed once per query) and leaves
+// one rotation per giant step per block:
+//     M q = sum_k rot( sum_b rot(D_{k*baby+b}, -k*baby) * rot(q, b), k*baby )
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "openfhe/pke/openfhe.h"
+#include "rotation.h"
+#include "rows.h"
+#include "scores.h"
+#include "store.h"
+#include "work_stealing.h"
+
+struct DiagonalLayout {
+    size_t count = 0;   // DB rows
+    size_t dim = 0;     // DB columns (power of two, divides slots)
+    size_t slots = 0;   // rows per block == CKKS slots
+    size_t baby = 0;    // baby-step count (power of two, divides dim)
+    size_t giant = 0;   // giant-step count, dim / baby
+    RotationKeyMode keys = RotationKeyMode::Exact;  // Minimal: Horner giant steps, sequential baby steps
+
+    size_t num_blocks() const { return (count + slots - 1) / slots; }
+};
+
+// Picks baby ~ sqrt(dim). Throws std::invalid_argument on non power-of-two dim or dim > slots.
+DiagonalLayout make_diagonal_layout(size_t count, size_t dim, size_t slots,
+                                    RotationKeyMode keys = RotationKeyMode::Exact);
+
+// Pre-rotated diagonal (k*baby + b) of row block `block`, ready to encode. The block's
+// rows must lie in `rows`.
+std::vector<double> diagonal_slots(const RowBlock &rows, const DiagonalLayout &layout, size_t block, size_t k,
+                                   size_t b);
+
+// Row blocks [first, last) covered by `rows`. Throws std::invalid_argument unless rows
+// starts on a block boundary and ends on one or at the last DB row.
+std::pair<size_t, size_t> diagonal_block_range(const RowBlock &rows, const DiagonalLayout &layout);
+
+// Query (dim values) repeated across every slot.
+std::vector<double> tile_query(const double *query, const DiagonalLayout &layout);
+
+// Exact: baby steps 1 .. baby-1 and giant steps baby, 2*baby, ..., (giant-1)*baby.
+// Minimal: 1 and baby only.
+std::vector<int32_t> matvec_rotations(const DiagonalLayout &layout);
+
+// Diagonals stored block-major: diags[(block * giant + k) * baby + b]. Elem is either
+// Plaintext (server-side gallery) or Ciphertext<DCRTPoly> (encrypted gallery).
+// encode_diagonals / encrypt_diagonals build them chunk by chunk (see parallel.h).
+template <class Elem>
+struct DiagonalMatrix {
+    DiagonalLayout layout;
+    std::vector<Elem> diags;
+
+    const Elem &at(size_t block, size_t k, size_t b) const {
+        return diags[(block * layout.giant + k) * layout.baby + b];
+    }
+};
+using PlainMatrix = DiagonalMatrix<lbcrypto::Plaintext>;
+using EncryptedMatrix = DiagonalMatrix<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>;
+
+// Encrypted diagonals served from an EncryptedStore (store.h) in the same order as
+// EncryptedMatrix::diags; each diagonal is deserialized the first time a shard needs it.
+struct StoredMatrix {
+    DiagonalLayout layout;
+    const EncryptedStore *store = nullptr;
+
+    lbcrypto::Ciphertext<lbcrypto::DCRTPoly> at(size_t block, size_t k, size_t b) const {
+        return store->shard((block * layout.giant + k) * layout.baby + b);
+    }
+};
+
+// Diagonals of the row blocks of diagonal_block_range(rows), in diags order and built
+// in parallel; appending the chunks' results in gallery order gives DiagonalMatrix::diags.
+// encode_diagonals encodes at `level`: the level of the baby-step ciphertexts it is
+// multiplied with (0 for a freshly encrypted query), so each plaintext holds only
+// that level's towers at the matching scale.
+std::vector<lbcrypto::Plaintext> encode_diagonals(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                  const RowBlock &rows, const DiagonalLayout &layout,
+                                                  uint32_t level = 0);
+std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> encrypt_diagonals(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc, const lbcrypto::PublicKey<lbcrypto::DCRTPoly> &pk,
+    const RowBlock &rows, const DiagonalLayout &layout);
+
+// rot(q, b) for b = 0 .. baby-1, hoisted (Exact) or as a chain of rotations by 1 (Minimal).
+// Computed once per query and shared by every block.
+std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> baby_steps(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+    const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &enc_query_tiled, const DiagonalLayout &layout);
+
+// M q for every row block and every probe of a batch, in one pass over the diagonals:
+// babies[q] = baby_steps() of probe q (each probe in its own tiled ciphertext, since
+// every slot already holds a DB row). One output ciphertext per block, slot i =
+// cos(q, v_i), padding rows set to SCORE_FLOOR. Costs one level. Returns one
+// EncryptedScores per probe; a single probe is a batch of one.
+//
+// Shards are (row block, giant step) pairs scheduled on `pool`; each shard fetches its
+// diagonals once and multiplies them into all probes, and each worker sums its shards
+// into per-block partial ciphertexts that are merged once all shards are done. With
+// RotationKeyMode::Minimal the shards leave their inner sums unrotated and each block is
+// merged Horner-style, rotating by baby between giant steps. A null pool runs every
+// shard on the calling thread.
+std::vector<EncryptedScores> matvec_batch_similarities(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+    const std::vector<std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>> &babies, const PlainMatrix &m,
+    WorkStealingPool *pool = nullptr);
+std::vector<EncryptedScores> matvec_batch_similarities(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+    const std::vector<std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>> &babies, const EncryptedMatrix &m,
+    WorkStealingPool *pool = nullptr);
+std::vector<EncryptedScores> matvec_batch_similarities(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+    const std::vector<std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>> &babies, const StoredMatrix &m,
+    WorkStealingPool *pool = nullptr);
@@ -0,0 +1,155 @@
+// metrics.cpp -- per-stage timing and memory instrumentation (see metrics.h)
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <sys/resource.h>
+
+double process_cpu_seconds() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+// Value of a "<field>:   <n> kB" line of /proc/self/status in bytes; 0 if absent.
+static uint64_t proc_status_bytes(const std::string &field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, field.size() + 1, field + ":") != 0) continue;
+        return std::strtoull(line.c_str() + field.size() + 1, nullptr, 10) * 1024;
+    }
+    return 0;
+}
+
+uint64_t current_rss_bytes() { return proc_status_bytes("VmRSS"); }
+
+uint64_t peak_rss_bytes() {
+    if (uint64_t hwm = proc_status_bytes("VmHWM")) return hwm;
+    // no /proc: lifetime peak only, and never reset
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return static_cast<uint64_t>(ru.ru_maxrss) * 1024;  // Linux reports kilobytes
+}
+
+bool reset_peak_rss() {
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";  // "reset the peak resident set size", see proc(5)
+    clear.close();
+    return static_cast<bool>(clear);
+}
+
+StageTimer::StageTimer(Metrics &metrics, std::string name)
+    : metrics_(&metrics), name_(std::move(name)), wall_start_(std::chrono::steady_clock::now()),
+      cpu_start_(process_cpu_seconds()), peak_reset_(reset_peak_rss()), rss_start_(current_rss_bytes()) {}
+
+StageTimer::~StageTimer() { stop(); }
+
+void StageTimer::stop(size_t ciphertexts) {
+    if (stopped_) return;
+    stopped_ = true;
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start_).count();
+    const uint64_t peak = peak_reset_ ? peak_rss_bytes() : std::max(rss_start_, current_rss_bytes());
+    metrics_->record(name_, wall, process_cpu_seconds() - cpu_start_, peak, ciphertexts);
+}
+
+void Metrics::record(const std::string &name, double wall_seconds, double cpu_seconds, uint64_t peak_rss,
+                     size_t ciphertexts) {
+    auto it = std::find_if(stages_.begin(), stages_.end(), [&](const StageMetrics &s) { return s.name == name; });
+    if (it == stages_.end()) {
+        stages_.push_back(StageMetrics{name});
+        it = stages_.end() - 1;
+    }
+    it->calls++;
+    it->wall_seconds += wall_seconds;
+    it->cpu_seconds += cpu_seconds;
+    it->peak_rss_bytes = std::max(it->peak_rss_bytes, peak_rss);
+    it->ciphertexts += ciphertexts;
+}
+
+// Stage names are plain identifiers chosen by the caller; escape just in case.
+static std::string escaped(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static StageMetrics total_of(const std::vector<StageMetrics> &stages) {
+    StageMetrics total{"total"};
+    for (const auto &s : stages) {
+        total.calls += s.calls;
+        total.wall_seconds += s.wall_seconds;
+        total.cpu_seconds += s.cpu_seconds;
+        total.peak_rss_bytes = std::max(total.peak_rss_bytes, s.peak_rss_bytes);
+        total.ciphertexts += s.ciphertexts;
+    }
+    return total;
+}
+
+static void json_stage(std::ostream &os, const StageMetrics &s) {
+    os << "{\"name\": \"" << escaped(s.name) << "\", \"calls\": " << s.calls << ", \"wall_seconds\": " << s.wall_seconds
+       << ", \"cpu_seconds\": " << s.cpu_seconds << ", \"peak_rss_bytes\": " << s.peak_rss_bytes
+       << ", \"ciphertexts\": " << s.ciphertexts << "}";
+}
+
+std::string Metrics::to_json() const {
+    std::ostringstream os;
+    os.precision(6);
+    os << "{\n  \"stages\": [\n";
+    for (size_t i = 0; i < stages_.size(); i++) {
+        os << "    ";
+        json_stage(os, stages_[i]);
+        os << (i + 1 < stages_.size() ? ",\n" : "\n");
+    }
+    os << "  ],\n  \"total\": ";
+    json_stage(os, total_of(stages_));
+    os << "\n}\n";
+    return os.str();
+}
+
+std::string Metrics::to_prometheus(const std::string &prefix) const {
+    struct Gauge {
+        const char *name;
+        const char *help;
+        double (*value)(const StageMetrics &);
+    };
+    static const Gauge GAUGES[] = {
+        {"wall_seconds", "Wall-clock time spent in the stage.", [](const StageMetrics &s) { return s.wall_seconds; }},
+        {"cpu_seconds", "Process CPU time (all threads) spent in the stage.",
+         [](const StageMetrics &s) { return s.cpu_seconds; }},
+        {"peak_rss_bytes", "Peak resident set size reached during the stage.",
+         [](const StageMetrics &s) { return static_cast<double>(s.peak_rss_bytes); }},
+        {"ciphertexts", "Ciphertexts produced by the stage.",
+         [](const StageMetrics &s) { return static_cast<double>(s.ciphertexts); }},
+        {"calls", "Times the stage ran.", [](const StageMetrics &s) { return static_cast<double>(s.calls); }},
+    };
+    std::ostringstream os;
+    os.precision(9);
+    for (const auto &g : GAUGES) {
+        const std::string metric = prefix + "_stage_" + g.name;
+        os << "# HELP " << metric << " " << g.help << "\n# TYPE " << metric << " gauge\n";
+        for (const auto &s : stages_) os << metric << "{stage=\"" << escaped(s.name) << "\"} " << g.value(s) << "\n";
+    }
+    return os.str();
+}
+
+static void write_file(const std::string &path, const std::string &text) {
+    std::ofstream os(path, std::ios::trunc);
+    os << text;
+    if (!os) throw std::runtime_error("metrics: cannot write " + path);
+}
+
+void Metrics::write_json(const std::string &path) const { write_file(path, to_json()); }
+
+void Metrics::write_prometheus(const std::string &path, const std::string &prefix) const {
+    write_file(path, to_prometheus(prefix));
+}
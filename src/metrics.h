@@ -0,0 +1,85 @@
+// metrics.h -- per-stage timing and memory instrumentation
+//
+// The pipeline is a sequence of stages (keygen, encode, encrypt, similarity,
+// reduction, compare, decrypt). Each stage is bracketed with a StageTimer, which
+// records wall time, process CPU time (all threads, from getrusage), the peak RSS
+// reached while the stage ran, and the number of ciphertexts the stage produced. The
+// peak is per stage: each StageTimer resets the kernel's RSS high-water mark (VmHWM,
+// via /proc/self/clear_refs) when it starts and reads it back when it stops. Where the
+// reset is not available, the larger of the RSS at start and stop is recorded instead.
+// Stages that run more than once (e.g. one reduction per query ciphertext) are
+// accumulated under their name.
+//
+// The collected table is exported as JSON and, optionally, in the Prometheus text
+// exposition format so runs with different parameters can be diffed stage by stage.
+// Stages are meant to be opened and closed from the driving thread, one at a time (a
+// nested stage would reset the outer stage's peak); the work inside them may be parallel.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct StageMetrics {
+    std::string name;
+    size_t calls = 0;
+    double wall_seconds = 0;
+    double cpu_seconds = 0;       // user + system, summed over every thread
+    uint64_t peak_rss_bytes = 0;  // highest RSS reached during the stage (max over calls)
+    size_t ciphertexts = 0;       // ciphertexts produced by the stage
+};
+
+class Metrics;
+
+// Measures one execution of a stage; stop() (or the destructor) adds it to the Metrics.
+class StageTimer {
+public:
+    StageTimer(Metrics &metrics, std::string name);
+    ~StageTimer();
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    // Records the stage; later calls are no-ops.
+    void stop(size_t ciphertexts = 0);
+
+private:
+    Metrics *metrics_;
+    std::string name_;
+    std::chrono::steady_clock::time_point wall_start_;
+    double cpu_start_;
+    bool peak_reset_;     // reset_peak_rss() succeeded at the start
+    uint64_t rss_start_;  // fallback when it did not
+    bool stopped_ = false;
+};
+
+class Metrics {
+public:
+    // Stages in first-seen order.
+    const std::vector<StageMetrics> &stages() const { return stages_; }
+
+    void record(const std::string &name, double wall_seconds, double cpu_seconds, uint64_t peak_rss_bytes,
+                size_t ciphertexts);
+
+    // {"stages": [{"name": ..., "calls": ..., "wall_seconds": ..., ...}, ...], "total": {...}}
+    std::string to_json() const;
+    // Gauges <prefix>_stage_{wall_seconds,cpu_seconds,peak_rss_bytes,ciphertexts,calls}{stage="..."}.
+    std::string to_prometheus(const std::string &prefix = "mercle_he") const;
+
+    // Write the respective format to `path`. Throw std::runtime_error on I/O failure.
+    void write_json(const std::string &path) const;
+    void write_prometheus(const std::string &path, const std::string &prefix = "mercle_he") const;
+
+private:
+    std::vector<StageMetrics> stages_;
+};
+
+// Process CPU time (user + system, all threads).
+double process_cpu_seconds();
+// Current RSS, and peak RSS since the last reset_peak_rss() (process start if none).
+uint64_t current_rss_bytes();
+uint64_t peak_rss_bytes();
+// Resets the peak to the current RSS (Linux >= 4.0); false if the kernel refused.
+bool reset_peak_rss();
@@ -0,0 +1,407 @@
+// multiparty.cpp -- threshold key generation and decryption with party processes (see multiparty.h)
+
+#include "multiparty.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "ciphertext-ser.h"
+#include "cryptocontext-ser.h"
+#include "key/key-ser.h"
+#include "scheme/ckksrns/ckksrns-ser.h"
+
+using namespace lbcrypto;
+
+using RotationKeys = std::map<uint32_t, EvalKey<DCRTPoly>>;
+
+// Every request is answered with a message of the same op, or Error carrying what().
+enum class PartyOp : uint32_t { Context, KeyGen, MultShare, MultFinal, RotShare, Decrypt, Shutdown, Error };
+
+struct Message {
+    PartyOp op = PartyOp::Error;
+    std::string body;
+};
+
+// ---------- framing: u32 op, u64 body length, body ----------
+
+static void write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) throw std::runtime_error(std::string("party socket: write failed: ") + std::strerror(errno));
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+}
+
+static void read_all(int fd, char *p, size_t n) {
+    while (n > 0) {
+        ssize_t r = ::recv(fd, p, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r == 0) throw std::runtime_error("party socket: connection closed");
+        if (r < 0) throw std::runtime_error(std::string("party socket: read failed: ") + std::strerror(errno));
+        p += r;
+        n -= static_cast<size_t>(r);
+    }
+}
+
+static std::string frame(PartyOp op, const std::string &body) {
+    const uint32_t code = static_cast<uint32_t>(op);
+    const uint64_t length = body.size();
+    std::string out(sizeof(code) + sizeof(length), '\0');
+    std::memcpy(&out[0], &code, sizeof(code));
+    std::memcpy(&out[sizeof(code)], &length, sizeof(length));
+    return out + body;
+}
+
+static Message read_message(int fd) {
+    uint32_t code;
+    uint64_t length;
+    char header[sizeof(code) + sizeof(length)];
+    read_all(fd, header, sizeof(header));
+    std::memcpy(&code, header, sizeof(code));
+    std::memcpy(&length, header + sizeof(code), sizeof(length));
+    Message m;
+    m.op = static_cast<PartyOp>(code);
+    m.body.resize(length);
+    if (length) read_all(fd, &m.body[0], length);
+    return m;
+}
+
+// ---------- bodies: length-prefixed parts of OpenFHE binary serializations ----------
+
+static std::string pack(const std::vector<std::string> &parts) {
+    std::string out;
+    for (const auto &part : parts) {
+        const uint64_t length = part.size();
+        out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        out += part;
+    }
+    return out;
+}
+
+static std::vector<std::string> unpack(const std::string &body) {
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (pos < body.size()) {
+        uint64_t length;
+        if (body.size() - pos < sizeof(length)) throw std::runtime_error("party message: truncated");
+        std::memcpy(&length, body.data() + pos, sizeof(length));
+        pos += sizeof(length);
+        if (body.size() - pos < length) throw std::runtime_error("party message: truncated");
+        parts.push_back(body.substr(pos, length));
+        pos += length;
+    }
+    return parts;
+}
+
+template <class T>
+static std::string to_bytes(const T &obj) {
+    std::stringstream ss;
+    Serial::Serialize(obj, ss, SerType::BINARY);
+    return ss.str();
+}
+
+template <class T>
+static T from_bytes(const std::string &bytes) {
+    std::stringstream ss(bytes);
+    T obj;
+    Serial::Deserialize(obj, ss, SerType::BINARY);
+    return obj;
+}
+
+static std::string index_bytes(const std::vector<int32_t> &indices) {
+    return std::string(reinterpret_cast<const char *>(indices.data()), indices.size() * sizeof(int32_t));
+}
+
+static std::vector<int32_t> indices_from(const std::string &bytes) {
+    std::vector<int32_t> indices(bytes.size() / sizeof(int32_t));
+    if (!indices.empty()) std::memcpy(indices.data(), bytes.data(), indices.size() * sizeof(int32_t));
+    return indices;
+}
+
+// ---------- party process ----------
+
+struct PartyState {
+    CryptoContext<DCRTPoly> cc;
+    KeyPair<DCRTPoly> kp;
+    bool lead = false;  // party 0: starts the key chain, runs MultipartyDecryptLead
+};
+
+static std::string serve(PartyState &st, const Message &m) {
+    const std::vector<std::string> in = unpack(m.body);
+    switch (m.op) {
+    case PartyOp::Context:
+        st.cc = from_bytes<CryptoContext<DCRTPoly>>(in.at(0));
+        return "";
+    case PartyOp::KeyGen:
+        st.lead = in.at(0).empty();
+        st.kp = st.lead ? st.cc->KeyGen() : st.cc->MultipartyKeyGen(from_bytes<PublicKey<DCRTPoly>>(in[0]));
+        if (!st.kp.good()) throw std::runtime_error("key generation failed");
+        return pack({to_bytes(st.kp.publicKey)});
+    case PartyOp::MultShare: {
+        const PrivateKey<DCRTPoly> &sk = st.kp.secretKey;
+        EvalKey<DCRTPoly> share = st.lead ? st.cc->KeySwitchGen(sk, sk)
+                                          : st.cc->MultiKeySwitchGen(sk, sk, from_bytes<EvalKey<DCRTPoly>>(in.at(0)));
+        return pack({to_bytes(share)});
+    }
+    case PartyOp::MultFinal:
+        return pack({to_bytes(st.cc->MultiMultEvalKey(st.kp.secretKey, from_bytes<EvalKey<DCRTPoly>>(in.at(0)), in.at(1)))});
+    case PartyOp::RotShare: {
+        const std::vector<int32_t> indices = indices_from(in.at(0));
+        std::shared_ptr<RotationKeys> keys;
+        if (st.lead) {
+            st.cc->EvalAtIndexKeyGen(st.kp.secretKey, indices);
+            keys = st.cc->GetEvalAutomorphismKeyMapPtr(st.kp.secretKey->GetKeyTag());
+        } else {
+            auto lead = std::make_shared<RotationKeys>(from_bytes<RotationKeys>(in.at(1)));
+            keys = st.cc->MultiEvalAtIndexKeyGen(st.kp.secretKey, lead, indices, in.at(2));
+        }
+        return pack({to_bytes(*keys)});
+    }
+    case PartyOp::Decrypt: {
+        std::vector<Ciphertext<DCRTPoly>> cts;
+        for (const auto &part : in) cts.push_back(from_bytes<Ciphertext<DCRTPoly>>(part));
+        std::vector<Ciphertext<DCRTPoly>> partial = st.lead ? st.cc->MultipartyDecryptLead(cts, st.kp.secretKey)
+                                                            : st.cc->MultipartyDecryptMain(cts, st.kp.secretKey);
+        std::vector<std::string> out;
+        for (const auto &ct : partial) out.push_back(to_bytes(ct));
+        return pack(out);
+    }
+    default:
+        throw std::runtime_error("unexpected request " + std::to_string(static_cast<uint32_t>(m.op)));
+    }
+}
+
+int run_party(int fd, int threads) {
+#ifdef _OPENMP
+    // the parties share the machine: split the cores instead of each starting a full team
+    if (threads > 0) omp_set_num_threads(threads);
+#else
+    (void)threads;
+#endif
+    PartyState st;
+    for (;;) {
+        Message m;
+        try {
+            m = read_message(fd);
+        } catch (const std::exception &) {
+            return 1;  // coordinator went away
+        }
+        if (m.op == PartyOp::Shutdown) return 0;
+        Message reply;
+        reply.op = m.op;
+        try {
+            reply.body = serve(st, m);
+        } catch (const std::exception &e) {
+            reply.op = PartyOp::Error;
+            reply.body = e.what();
+        }
+        try {
+            const std::string out = frame(reply.op, reply.body);
+            write_all(fd, out.data(), out.size());
+        } catch (const std::exception &) {
+            return 1;
+        }
+    }
+}
+
+// ---------- coordinator ----------
+
+// Sends go through a writer thread so that queuing a large request never blocks the
+// coordinator while the party is itself blocked writing a large reply.
+class ThresholdParties::Channel {
+public:
+    explicit Channel(int fd) : fd_(fd), writer_([this] { write_loop(); }) {}
+    ~Channel() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            closing_ = true;
+        }
+        cv_.notify_all();
+        writer_.join();
+        ::close(fd_);
+    }
+
+    void send(PartyOp op, const std::string &body) {
+        std::string out = frame(op, body);
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            queue_.push_back(std::move(out));
+        }
+        cv_.notify_all();
+    }
+
+    // Next reply, which must answer `op`. Throws std::runtime_error with the party's error.
+    std::string recv(PartyOp op) {
+        Message m = read_message(fd_);
+        if (m.op == PartyOp::Error) throw std::runtime_error("party: " + m.body);
+        if (m.op != op) throw std::runtime_error("party: reply out of order");
+        return m.body;
+    }
+
+    // recv() of a single-part reply.
+    std::string recv_one(PartyOp op) { return unpack(recv(op)).at(0); }
+
+private:
+    void write_loop() {
+        for (;;) {
+            std::string next;
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [&] { return closing_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                next = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            try {
+                write_all(fd_, next.data(), next.size());
+            } catch (const std::exception &) {
+                return;  // the party is gone; recv() reports it
+            }
+        }
+    }
+
+    int fd_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<std::string> queue_;
+    bool closing_ = false;
+    std::thread writer_;  // last: starts once the members above exist
+};
+
+ThresholdParties::ThresholdParties(size_t parties, const std::string &exe) {
+    if (parties < 2) throw std::invalid_argument("ThresholdParties: need at least two parties");
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const std::string threads_arg = std::to_string(std::max<size_t>(1, cores / parties));
+    try {
+        for (size_t i = 0; i < parties; i++) {
+            int sv[2];
+            if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+                throw std::runtime_error(std::string("ThresholdParties: socketpair: ") + std::strerror(errno));
+            const std::string fd_arg = std::to_string(sv[1]);
+            pid_t pid = ::fork();
+            if (pid == 0) {
+                // only async-signal-safe calls until exec; the party keeps just its own end
+                ::fcntl(sv[1], F_SETFD, 0);
+                ::execl(exe.c_str(), exe.c_str(), PARTY_FLAG, fd_arg.c_str(), threads_arg.c_str(),
+                        static_cast<char *>(nullptr));
+                ::_exit(127);
+            }
+            ::close(sv[1]);
+            if (pid < 0) {
+                ::close(sv[0]);
+                throw std::runtime_error(std::string("ThresholdParties: fork: ") + std::strerror(errno));
+            }
+            pids_.push_back(pid);
+            channels_.emplace_back(new Channel(sv[0]));
+        }
+    } catch (...) {
+        shutdown();
+        throw;
+    }
+}
+
+ThresholdParties::~ThresholdParties() { shutdown(); }
+
+void ThresholdParties::shutdown() noexcept {
+    for (auto &ch : channels_) ch->send(PartyOp::Shutdown, "");
+    channels_.clear();  // drains the queues and closes the sockets
+    for (pid_t pid : pids_) {
+        int status;
+        while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+    pids_.clear();
+}
+
+PublicKey<DCRTPoly> ThresholdParties::keygen(const CryptoContext<DCRTPoly> &cc, const std::vector<int32_t> &rotations) {
+    cc_ = cc;
+    const size_t n = size();
+    const std::string ctx = pack({to_bytes(cc)});
+    for (auto &ch : channels_) ch->send(PartyOp::Context, ctx);
+
+    // 1. public key chain; party 0 starts on its relinearization and rotation keys
+    //    as soon as it has a secret key, while the chain runs through the others
+    const std::string idx = index_bytes(rotations);
+    channels_[0]->send(PartyOp::KeyGen, pack({""}));
+    channels_[0]->recv(PartyOp::Context);
+    std::string pk = channels_[0]->recv_one(PartyOp::KeyGen);
+    channels_[0]->send(PartyOp::MultShare, pack({""}));
+    channels_[0]->send(PartyOp::RotShare, pack({idx, "", ""}));
+    for (size_t i = 1; i < n; i++) {
+        channels_[i]->send(PartyOp::KeyGen, pack({pk}));
+        channels_[i]->recv(PartyOp::Context);
+        pk = channels_[i]->recv_one(PartyOp::KeyGen);
+    }
+    PublicKey<DCRTPoly> joint = from_bytes<PublicKey<DCRTPoly>>(pk);
+    const std::string tag = joint->GetKeyTag();
+
+    // 2./3. the other parties' shares against party 0's keys, both queued back to back
+    const std::string lead_mult = channels_[0]->recv_one(PartyOp::MultShare);
+    for (size_t i = 1; i < n; i++) channels_[i]->send(PartyOp::MultShare, pack({lead_mult}));
+    const std::string lead_rot = channels_[0]->recv_one(PartyOp::RotShare);
+    for (size_t i = 1; i < n; i++) channels_[i]->send(PartyOp::RotShare, pack({idx, lead_rot, tag}));
+
+    EvalKey<DCRTPoly> mult_sum = from_bytes<EvalKey<DCRTPoly>>(lead_mult);
+    for (size_t i = 1; i < n; i++)
+        mult_sum = cc->MultiAddEvalKeys(mult_sum,
+                                        from_bytes<EvalKey<DCRTPoly>>(channels_[i]->recv_one(PartyOp::MultShare)), tag);
+    const std::string final_req = pack({to_bytes(mult_sum), tag});
+    for (auto &ch : channels_) ch->send(PartyOp::MultFinal, final_req);
+
+    // rotation keys are summed while the parties work on the final relinearization round
+    auto rot = std::make_shared<RotationKeys>(from_bytes<RotationKeys>(lead_rot));
+    for (size_t i = 1; i < n; i++) {
+        auto share = std::make_shared<RotationKeys>(from_bytes<RotationKeys>(channels_[i]->recv_one(PartyOp::RotShare)));
+        rot = cc->MultiAddEvalAutomorphismKeys(rot, share, tag);
+    }
+    EvalKey<DCRTPoly> mult;
+    for (auto &ch : channels_) {
+        EvalKey<DCRTPoly> share = from_bytes<EvalKey<DCRTPoly>>(ch->recv_one(PartyOp::MultFinal));
+        mult = mult ? cc->MultiAddEvalMultKeys(mult, share, tag) : share;
+    }
+    cc->InsertEvalMultKey({mult});
+    if (!rotations.empty()) cc->InsertEvalAutomorphismKey(rot, tag);
+    return joint;
+}
+
+std::vector<Plaintext> ThresholdParties::decrypt(const std::vector<Ciphertext<DCRTPoly>> &cts) {
+    if (!cc_) throw std::runtime_error("ThresholdParties::decrypt: no keys generated");
+    std::vector<std::string> parts;
+    for (const auto &ct : cts) parts.push_back(to_bytes(ct));
+    const std::string req = pack(parts);  // serialized once for every party
+    for (auto &ch : channels_) ch->send(PartyOp::Decrypt, req);
+
+    // partial[party][ct]
+    std::vector<std::vector<Ciphertext<DCRTPoly>>> partial(size());
+    for (size_t i = 0; i < size(); i++)
+        for (const auto &part : unpack(channels_[i]->recv(PartyOp::Decrypt)))
+            partial[i].push_back(from_bytes<Ciphertext<DCRTPoly>>(part));
+
+    std::vector<Plaintext> out(cts.size());
+    for (size_t c = 0; c < cts.size(); c++) {
+        std::vector<Ciphertext<DCRTPoly>> shares;
+        for (size_t i = 0; i < size(); i++) shares.push_back(partial[i].at(c));
+        cc_->MultipartyDecryptFusion(shares, &out[c]);
+    }
+    return out;
+}
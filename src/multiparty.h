@@ -0,0 +1,82 @@
+// multiparty.h -- N-party threshold key generation and decryption with local party processes
+//
+// Each party is a separate process (this binary re-executed with PARTY_FLAG) that owns
+// its secret key share and talks to the coordinator -- the evaluating server -- over a
+// Unix socket pair. The coordinator never holds a secret key: it drives OpenFHE's
+// additive N-of-N threshold protocol and keeps only public material.
+//
+// Key generation
+//   1. public key chain: party 0 KeyGen(), party i MultipartyKeyGen(pk_{i-1}); the
+//      last public key is the joint key
+//   2. relinearization: party 0 KeySwitchGen(s0, s0), every other party
+//      MultiKeySwitchGen against it; the coordinator adds the shares, every party
+//      MultiMultEvalKey's the sum and the coordinator adds those (MultiAddEvalMultKeys)
+//   3. rotations: party 0 EvalAtIndexKeyGen, every other party MultiEvalAtIndexKeyGen
+//      against party 0's keys; the coordinator adds the maps. These are also the
+//      circuit's summation keys: every fold is a rotate-and-add over them.
+// The rounds are pipelined. Requests are queued on a party's socket as soon as their
+// inputs exist, so party 0 generates its relinearization and rotation shares while
+// the public key chain is still running through the other parties, and a party with
+// queued work never waits on a round barrier.
+//
+// Decryption
+//   Every party receives the whole batch of ciphertexts in one message and computes its
+//   partial decryptions (MultipartyDecryptLead for party 0, MultipartyDecryptMain for
+//   the others) concurrently with the rest; the coordinator fuses them
+//   (MultipartyDecryptFusion). One round trip per batch: the added latency is one
+//   partial decryption plus moving a few low-level ciphertexts over the sockets.
+//
+// OpenFHE's multiparty bootstrapping is interactive, so there are no joint bootstrapping
+// keys: plan the circuit without refreshes when using parties.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "openfhe/pke/openfhe.h"
+
+// argv[1] that turns the process into a party; argv[2] is the socket descriptor and
+// argv[3] the OpenMP threads the party may use.
+constexpr const char *PARTY_FLAG = "--party";
+
+// Serves party requests on `fd` until the coordinator shuts it down. Returns the
+// process exit code.
+int run_party(int fd, int threads);
+
+class ThresholdParties {
+public:
+    // Starts `parties` party processes by executing `exe PARTY_FLAG <fd> <threads>`; the executable
+    // must call run_party() when it sees PARTY_FLAG. Throws std::invalid_argument for
+    // fewer than two parties and std::runtime_error if a process cannot be started.
+    explicit ThresholdParties(size_t parties, const std::string &exe = "/proc/self/exe");
+    // Shuts every party down and reaps it.
+    ~ThresholdParties();
+
+    ThresholdParties(const ThresholdParties &) = delete;
+    ThresholdParties &operator=(const ThresholdParties &) = delete;
+
+    size_t size() const { return pids_.size(); }
+
+    // Runs the key generation protocol for `cc` (MULTIPARTY enabled, no keys yet) and
+    // installs the joint relinearization and rotation keys into it. Returns the joint
+    // public key. Throws std::runtime_error if a party fails.
+    lbcrypto::PublicKey<lbcrypto::DCRTPoly> keygen(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                   const std::vector<int32_t> &rotations);
+
+    // Threshold decryption of a batch (all parties in parallel, one round trip).
+    std::vector<lbcrypto::Plaintext> decrypt(const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> &cts);
+
+private:
+    class Channel;  // framed messages over one party's socket, with a background writer
+
+    void shutdown() noexcept;
+
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc_;
+    std::vector<pid_t> pids_;
+    std::vector<std::unique_ptr<Channel>> channels_;
+};
@@ -0,0 +1,157 @@
+// packing.cpp -- multi-vector slot packing (see packing.h)
+
+#include "packing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "parallel.h"
+#include "rotation.h"
+
+using namespace lbcrypto;
+
+static bool is_power_of_two(size_t x) { return x != 0 && (x & (x - 1)) == 0; }
+
+PackedLayout make_packed_layout(size_t count, size_t dim, size_t slots, RotationKeyMode keys, size_t regions) {
+    if (!is_power_of_two(dim))
+        throw std::invalid_argument("packed layout: dim must be a power of two");
+    if (!is_power_of_two(regions))
+        throw std::invalid_argument("packed layout: regions must be a power of two");
+    if (dim * regions > slots)
+        throw std::invalid_argument("packed layout: dim x regions exceeds slot count");
+    PackedLayout layout;
+    layout.count = count;
+    layout.dim = dim;
+    layout.slots = slots;
+    layout.regions = regions;
+    layout.per_ct = layout.region_width() / dim;
+    layout.fold_radix = fold_radix(keys);
+    return layout;
+}
+
+std::vector<double> pack_vectors(const RowBlock &rows, const PackedLayout &layout, size_t ct_index) {
+    std::vector<double> slots(layout.slots, 0.0);
+    size_t first = ct_index * layout.per_ct;
+    size_t last = std::min(first + layout.per_ct, layout.count);
+    for (size_t r = 0; r < layout.regions; r++)
+        for (size_t i = first; i < last; i++)
+            std::copy(rows.row(i), rows.row(i) + layout.dim,
+                      slots.begin() + r * layout.region_width() + (i - first) * layout.dim);
+    return slots;
+}
+
+std::pair<size_t, size_t> packed_ct_range(const RowBlock &rows, const PackedLayout &layout) {
+    if (rows.dim != layout.dim) throw std::invalid_argument("packed_ct_range: row dimension differs from layout");
+    if (rows.first % layout.per_ct != 0 || (rows.end() % layout.per_ct != 0 && rows.end() != layout.count) ||
+        rows.end() > layout.count)
+        throw std::invalid_argument("packed_ct_range: rows do not cover whole ciphertexts");
+    return {rows.first / layout.per_ct, (rows.end() + layout.per_ct - 1) / layout.per_ct};
+}
+
+std::vector<Ciphertext<DCRTPoly>> encrypt_packed(const CryptoContext<DCRTPoly> &cc,
+                                                 const PublicKey<DCRTPoly> &pk, const RowBlock &rows,
+                                                 const PackedLayout &layout) {
+    const auto range = packed_ct_range(rows, layout);
+    std::vector<Ciphertext<DCRTPoly>> out(range.second - range.first);
+    parallel_for(out.size(), [&](size_t c) {
+        out[c] = cc->Encrypt(pk, cc->MakeCKKSPackedPlaintext(pack_vectors(rows, layout, range.first + c)));
+    });
+    return out;
+}
+
+std::vector<Plaintext> encode_packed(const CryptoContext<DCRTPoly> &cc, const RowBlock &rows,
+                                     const PackedLayout &layout, uint32_t level) {
+    const auto range = packed_ct_range(rows, layout);
+    std::vector<Plaintext> out(range.second - range.first);
+    parallel_for(out.size(), [&](size_t c) {
+        out[c] = cc->MakeCKKSPackedPlaintext(pack_vectors(rows, layout, range.first + c), 1, level);
+    });
+    return out;
+}
+
+std::vector<double> replicate_probes(const Matrix<double> &probes, const PackedLayout &layout, size_t group) {
+    std::vector<double> slots(layout.slots, 0.0);
+    for (size_t r = 0; r < layout.regions; r++) {
+        size_t p = group * layout.regions + r;
+        if (p >= probes.rows()) break;
+        for (size_t b = 0; b < layout.per_ct; b++)
+            std::copy(probes.row(p), probes.row(p) + layout.dim,
+                      slots.begin() + r * layout.region_width() + b * layout.dim);
+    }
+    return slots;
+}
+
+std::vector<int32_t> block_sum_rotations(const PackedLayout &layout) {
+    return fold_sum_rotations(layout.dim, 1, layout.fold_radix);
+}
+
+Ciphertext<DCRTPoly> block_sum(const CryptoContext<DCRTPoly> &cc, const Ciphertext<DCRTPoly> &ct,
+                               const PackedLayout &layout) {
+    return fold_sum(cc, ct, layout.dim, 1, layout.fold_radix);
+}
+
+std::vector<double> score_mask(const PackedLayout &layout, size_t ct_index) {
+    std::vector<double> mask(layout.slots, 0.0);
+    size_t first = ct_index * layout.per_ct;
+    size_t valid = std::min(layout.per_ct, layout.count - first);
+    for (size_t r = 0; r < layout.regions; r++)
+        for (size_t b = 0; b < valid; b++) mask[r * layout.region_width() + b * layout.dim] = 1.0;
+    return mask;
+}
+
+std::vector<double> score_floor(const PackedLayout &layout, size_t ct_index) {
+    std::vector<double> floor = score_mask(layout, ct_index);
+    for (double &x : floor) x = (x == 0.0) ? SCORE_FLOOR : 0.0;
+    return floor;
+}
+
+// Shared by the packed similarity entry points; shard(c) yields DB entry c (ciphertext
+// or plaintext). Tasks are DB entries, so each entry is fetched once for all groups.
+template <class Shard>
+static std::vector<EncryptedScores> packed_impl(const CryptoContext<DCRTPoly> &cc,
+                                                const std::vector<Ciphertext<DCRTPoly>> &enc_queries,
+                                                size_t num_cts, Shard shard, const PackedLayout &layout,
+                                                WorkStealingPool *pool) {
+    std::vector<EncryptedScores> out(enc_queries.size());
+    for (auto &scores : out) {
+        scores.count = layout.count;
+        scores.per_ct = layout.per_ct;
+        scores.stride = layout.dim;
+        scores.cts.resize(num_cts);
+    }
+    WorkStealingPool::run_on(pool, num_cts, [&](size_t c, size_t) {
+        const auto entry = shard(c);
+        // Block-straddling partial sums would fall outside [-1, 1] and poison any
+        // later polynomial stage, so keep only the block heads.
+        Plaintext mask = cc->MakeCKKSPackedPlaintext(score_mask(layout, c));
+        Plaintext floor = cc->MakeCKKSPackedPlaintext(score_floor(layout, c));
+        for (size_t g = 0; g < enc_queries.size(); g++) {
+            Ciphertext<DCRTPoly> dot = block_sum(cc, cc->EvalMult(enc_queries[g], entry), layout);
+            out[g].cts[c] = cc->EvalAdd(cc->EvalMult(dot, mask), floor);
+        }
+    });
+    return out;
+}
+
+std::vector<EncryptedScores> packed_batch_similarities(const CryptoContext<DCRTPoly> &cc,
+                                                       const std::vector<Ciphertext<DCRTPoly>> &enc_queries,
+                                                       const std::vector<Ciphertext<DCRTPoly>> &enc_db,
+                                                       const PackedLayout &layout, WorkStealingPool *pool) {
+    return packed_impl(cc, enc_queries, enc_db.size(), [&](size_t c) { return enc_db[c]; }, layout, pool);
+}
+
+std::vector<EncryptedScores> packed_batch_similarities(const CryptoContext<DCRTPoly> &cc,
+                                                       const std::vector<Ciphertext<DCRTPoly>> &enc_queries,
+                                                       const std::vector<Plaintext> &plain_db,
+                                                       const PackedLayout &layout, WorkStealingPool *pool) {
+    return packed_impl(cc, enc_queries, plain_db.size(), [&](size_t c) { return plain_db[c]; }, layout, pool);
+}
+
+std::vector<EncryptedScores> packed_batch_similarities(const CryptoContext<DCRTPoly> &cc,
+                                                       const std::vector<Ciphertext<DCRTPoly>> &enc_queries,
+                                                       const EncryptedStore &store, const PackedLayout &layout,
+                                                       WorkStealingPool *pool) {
+    if (store.size() != layout.num_cts())
+        throw std::invalid_argument("packed_batch_similarities: store does not hold this layout's ciphertexts");
+    return packed_impl(cc, enc_queries, store.size(), [&](size_t c) { return store.shard(c); }, layout, pool);
+}
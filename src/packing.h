@@ -0,0 +1,110 @@
+// packing.h -- multi-vector slot packing for the encrypted database
+//
+// floor(slots / dim) DB vectors are laid out back-to-back in each ciphertext.
+// The query is replicated once per block, so a single EvalMult multiplies it
+// against every packed vector, and a segmented fold over dim slots (hoisted,
+// see rotation.h) leaves each block's dot product in the block's first slot.
+//
+// Query batching: the slots can be split into `regions` equal regions, each holding
+// the same DB vectors and a different probe. One EvalMult per DB ciphertext then
+// scores `regions` probes at once, and the fold and tournaments (which never reach
+// past span * dim slots) stay inside each region: probe r's result ends up in slot
+// r * region_width(). The price is a DB replicated `regions` times.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "openfhe/pke/openfhe.h"
+#include "rotation.h"
+#include "rows.h"
+#include "scores.h"
+#include "store.h"
+#include "work_stealing.h"
+
+struct PackedLayout {
+    size_t count = 0;   // number of DB vectors
+    size_t dim = 0;     // vector dimension == block width (power of two)
+    size_t slots = 0;   // CKKS slots per ciphertext
+    size_t per_ct = 0;  // vectors per ciphertext (per region), region_width() / dim
+    size_t fold_radix = FOLD_RADIX;  // radix of the segmented fold (see RotationKeyMode)
+    size_t regions = 1; // probes per query ciphertext (power of two)
+
+    size_t num_cts() const { return (count + per_ct - 1) / per_ct; }
+    size_t region_width() const { return slots / regions; }
+    // Query ciphertexts needed for `probes` probes.
+    size_t num_query_cts(size_t probes) const { return (probes + regions - 1) / regions; }
+};
+
+// Throws std::invalid_argument if dim or regions is not a power of two, or a region
+// is narrower than dim.
+PackedLayout make_packed_layout(size_t count, size_t dim, size_t slots,
+                                RotationKeyMode keys = RotationKeyMode::Exact, size_t regions = 1);
+
+// Slot vector for ciphertext ct_index: vectors [ct_index*per_ct, ...) back-to-back,
+// repeated in every region. Those vectors must lie in `rows`.
+std::vector<double> pack_vectors(const RowBlock &rows, const PackedLayout &layout, size_t ct_index);
+
+// Ciphertexts [first, last) holding the vectors of `rows`. Throws std::invalid_argument
+// unless rows starts on a ciphertext boundary and ends on one or at the last vector.
+std::pair<size_t, size_t> packed_ct_range(const RowBlock &rows, const PackedLayout &layout);
+
+// Encodes and encrypts the ciphertexts of packed_ct_range(rows), in parallel across
+// ciphertexts. Streaming callers append the chunks' results in order.
+std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> encrypt_packed(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc, const lbcrypto::PublicKey<lbcrypto::DCRTPoly> &pk,
+    const RowBlock &rows, const PackedLayout &layout);
+
+// Server-side plaintext DB: the packed slot vectors of packed_ct_range(rows) encoded in
+// parallel at `level` (the level the query ciphertext has when it is multiplied in, 0
+// for a fresh encryption) so each plaintext carries only that level's towers and scale.
+std::vector<lbcrypto::Plaintext> encode_packed(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                               const RowBlock &rows, const PackedLayout &layout,
+                                               uint32_t level = 0);
+
+// Query ciphertext `group` of a batch: region r holds probe (row) group * regions + r,
+// repeated once per block (regions past the last probe stay zero).
+std::vector<double> replicate_probes(const Matrix<double> &probes, const PackedLayout &layout, size_t group);
+
+// Rotation indices needed by block_sum.
+std::vector<int32_t> block_sum_rotations(const PackedLayout &layout);
+
+// Segmented EvalSum: after the fold, the first slot of every block holds the sum
+// of that block. Other slots hold partial sums that straddle blocks.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> block_sum(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                   const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &ct,
+                                                   const PackedLayout &layout);
+
+// Mask keeping the first slot of every occupied block in every region (1) and clearing
+// the rest (0), and the matching additive floor (SCORE_FLOOR everywhere the mask is 0).
+std::vector<double> score_mask(const PackedLayout &layout, size_t ct_index);
+std::vector<double> score_floor(const PackedLayout &layout, size_t ct_index);
+
+// Full similarity stage for the packed layout, for a batch of probes in a single pass
+// over the DB: one query ciphertext per probe group (replicate_probes), every DB entry
+// fetched once and multiplied into all groups, then the segmented fold and mask + floor
+// so each result satisfies the EncryptedScores contract. Costs two levels (product and
+// mask). Each packed ciphertext is one shard on `pool` (null: calling thread). Returns
+// one EncryptedScores per group. A single probe is a batch of one.
+//
+// Against the encrypted DB, a pre-encoded plaintext DB (ciphertext x plaintext
+// products, no relinearization), or ciphertexts loaded lazily from an EncryptedStore
+// (store.h).
+std::vector<EncryptedScores> packed_batch_similarities(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+    const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> &enc_queries,
+    const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> &enc_db, const PackedLayout &layout,
+    WorkStealingPool *pool = nullptr);
+std::vector<EncryptedScores> packed_batch_similarities(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+    const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> &enc_queries,
+    const std::vector<lbcrypto::Plaintext> &plain_db, const PackedLayout &layout,
+    WorkStealingPool *pool = nullptr);
+std::vector<EncryptedScores> packed_batch_similarities(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+    const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> &enc_queries, const EncryptedStore &store,
+    const PackedLayout &layout, WorkStealingPool *pool = nullptr);
@@ -0,0 +1,15 @@
+// parallel.cpp -- outer-level parallelism (see parallel.h)
+
+#include "parallel.h"
+
+int configure_outer_parallelism(int threads) {
+#ifdef _OPENMP
+    if (threads > 0) omp_set_num_threads(threads);
+    // nested parallelism off: OpenFHE's internal loops run serially inside our regions
+    omp_set_max_active_levels(1);
+    return omp_get_max_threads();
+#else
+    (void)threads;
+    return 1;
+#endif
+}
@@ -0,0 +1,43 @@
+// parallel.h -- outer-level parallelism over independent ciphertexts
+//
+// OpenFHE parallelizes inside each operation (over RNS towers) with OpenMP. For bulk
+// work -- encrypting thousands of DB ciphertexts -- it is much better to run whole
+// operations side by side, one per core. configure_outer_parallelism() limits OpenMP
+// to one active level: inside our parallel_for regions OpenFHE's own loops run
+// serially (no oversubscription), while single-ciphertext stages outside them still
+// get OpenFHE's internal parallelism.
+
+#pragma once
+
+#include <cstddef>
+#include <exception>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// threads == 0: keep the OpenMP default (OMP_NUM_THREADS or all cores).
+// Returns the number of threads parallel_for will use.
+int configure_outer_parallelism(int threads);
+
+// body(i) for i in [0, n), dynamically scheduled across threads. Each index must write
+// only its own output slot (pre-size result vectors). The first exception thrown by
+// any body is rethrown on the calling thread.
+template <class Body>
+void parallel_for(size_t n, Body body) {
+    std::exception_ptr error;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (long long i = 0; i < static_cast<long long>(n); i++) {
+        try {
+            body(static_cast<size_t>(i));
+        } catch (...) {
+#ifdef _OPENMP
+#pragma omp critical(parallel_for_error)
+#endif
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,146 @@
+// planner.cpp -- level-aware depth planner (see planner.h)
+
+#include "planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+using namespace lbcrypto;
+
+static size_t next_power_of_two(size_t x) {
+    size_t p = 1;
+    while (p < x) p <<= 1;
+    return p;
+}
+
+// Largest log2(Q) (ciphertext modulus only) allowed per ring dimension at 128-bit
+// classical security (HE standard). The real context also holds key-switching
+// moduli, so the ring it gets is at least as large as the one picked here.
+static uint32_t min_ring_dim_128(uint32_t log_q) {
+    static const struct { uint32_t ring; uint32_t max_log_q; } TABLE[] = {
+        {1u << 13, 218}, {1u << 14, 438}, {1u << 15, 881}, {1u << 16, 1772}, {1u << 17, 3576},
+    };
+    for (const auto &row : TABLE)
+        if (log_q <= row.max_log_q) return row.ring;
+    return 1u << 17;
+}
+
+// Rule of thumb: encoding, rescaling and key-switching noise eat ~20 bits at the ring
+// sizes used here; keep ~6 more bits of guard above the target precision.
+static uint32_t scale_bits_for(double precision) {
+    uint32_t bits = static_cast<uint32_t>(std::ceil(-std::log2(precision))) + 26;
+    return std::clamp<uint32_t>(bits, 30, 50);
+}
+
+CircuitPlan plan_circuit(const PlanRequest &req) {
+    if (req.db_n == 0 || req.dim == 0) throw std::invalid_argument("plan_circuit: empty DB");
+    if (next_power_of_two(req.dim) != req.dim) throw std::invalid_argument("plan_circuit: dim must be a power of two");
+    if (req.probes == 0) throw std::invalid_argument("plan_circuit: no probes");
+
+    CircuitPlan plan;
+    plan.request = req;
+    plan.sign = sign_preset_for(req.precision, req.round_depth_limit);
+    plan.sim_depth = req.layout == SimilarityLayout::Packed ? 2 : 1;  // product (+ mask)
+
+    // Slots: enough for every score in one ciphertext when the ring allows it (for every
+    // probe of the batch, in the packed layout). Fixed below once the ring dimension
+    // lower bound is known.
+    size_t want_slots = req.layout == SimilarityLayout::Packed
+        ? next_power_of_two(req.db_n * req.dim) * next_power_of_two(req.probes)
+        : next_power_of_two(std::max(req.db_n, req.dim));
+
+    // Depth is independent of the slot count except through the number of rounds,
+    // so iterate: rounds -> depth -> ring -> slots -> rounds.
+    plan.slots = static_cast<uint32_t>(want_slots);
+    for (int iter = 0; iter < 4; iter++) {
+        // packed: one region per probe while a region still holds a whole vector;
+        // diagonal: every slot is a DB row, so each probe gets its own ciphertext
+        plan.regions = req.layout == SimilarityLayout::Packed
+            ? std::max<size_t>(1, std::min(next_power_of_two(req.probes), plan.slots / req.dim))
+            : 1;
+        plan.query_cts = (req.probes + plan.regions - 1) / plan.regions;
+        size_t per_ct = req.layout == SimilarityLayout::Packed ? plan.slots / plan.regions / req.dim : plan.slots;
+        if (per_ct == 0) throw std::invalid_argument("plan_circuit: dim exceeds slots");
+        if (req.mode == DecisionMode::Max) {
+            plan.rounds = tournament_rounds(req.db_n, per_ct);
+            plan.round_depth = plan.sign.approx.max_depth();
+            plan.compare_depth = plan.sign.approx.depth();
+        } else {
+            plan.rounds = threshold_reduce_depth(req.db_n, per_ct, req.reduction);
+            plan.round_depth = req.reduction == ThresholdReduction::Count ? 0 : 1;
+            // every slot of the reduced span of every score ciphertext contributes a bit
+            plan.step_bits = (req.db_n + per_ct - 1) / per_ct * tournament_span(req.db_n, per_ct);
+            plan.step = step_preset_for(req.step_margin, plan.step_bits);
+            plan.compare_depth = plan.step.approx.depth();
+        }
+        plan.circuit_depth = plan.sim_depth + plan.rounds * plan.round_depth + plan.compare_depth + plan.mask_depth;
+
+        plan.bootstrap.level_budget = req.bootstrap_level_budget;
+        plan.bootstrap.levels_after =
+            std::max(req.rounds_per_bootstrap * plan.round_depth, plan.compare_depth + plan.mask_depth);
+        plan.bootstrapping = req.allow_bootstrap &&
+                             plan.circuit_depth > bootstrap_context_depth(plan.bootstrap, UNIFORM_TERNARY);
+        plan.mult_depth = plan.bootstrapping ? bootstrap_context_depth(plan.bootstrap, UNIFORM_TERNARY)
+                                             : plan.circuit_depth;
+        plan.scale_bits = req.scale_bits ? req.scale_bits
+                        : plan.bootstrapping ? 50 : scale_bits_for(req.precision);
+        plan.first_mod_bits = 60;
+
+        uint32_t log_q = plan.first_mod_bits + plan.mult_depth * plan.scale_bits;
+        plan.min_ring_dim = req.security == HEStd_128_classic ? min_ring_dim_128(log_q) : (1u << 17);
+        uint32_t max_slots = plan.min_ring_dim / 2;
+        uint32_t slots = static_cast<uint32_t>(std::min<size_t>(want_slots, max_slots));
+        slots = std::max<uint32_t>(slots, static_cast<uint32_t>(req.dim));
+        if (slots == plan.slots && iter > 0) break;
+        plan.slots = slots;
+    }
+    if (plan.slots > plan.min_ring_dim / 2)
+        throw std::invalid_argument("plan_circuit: dim does not fit the ring dimension");
+    return plan;
+}
+
+CCParams<CryptoContextCKKSRNS> make_cc_params(const CircuitPlan &plan) {
+    CCParams<CryptoContextCKKSRNS> p;
+    p.SetMultiplicativeDepth(plan.mult_depth);
+    p.SetScalingModSize(plan.scale_bits);
+    p.SetFirstModSize(plan.first_mod_bits);
+    p.SetBatchSize(plan.slots);
+    p.SetSecurityLevel(plan.request.security);
+    if (plan.bootstrapping) {
+        // bootstrapping setup follows the OpenFHE CKKS bootstrapping examples
+        p.SetSecretKeyDist(UNIFORM_TERNARY);
+        p.SetScalingTechnique(FLEXIBLEAUTO);
+    }
+    return p;
+}
+
+std::string CircuitPlan::describe() const {
+    std::ostringstream os;
+    os << "  - slots " << slots << ", ring >= " << min_ring_dim << "\n";
+    if (request.probes > 1)
+        os << "  - batch: " << request.probes << " probes, " << regions << " per query ciphertext, "
+           << query_cts << " query ciphertext(s)\n";
+    os
+       << "  - depth: similarity " << sim_depth << " + " << rounds << " rounds x " << round_depth
+       << " + compare " << compare_depth << " + mask " << mask_depth << " = " << circuit_depth << "\n";
+    if (request.mode == DecisionMode::Max)
+        os << "  - sign polynomial: g" << sign.approx.g_n << "^" << sign.approx.g_iters << " then f"
+           << sign.approx.f_n << "^" << sign.approx.f_iters << " (max error " << sign.max_error
+           << (sign.max_error > request.precision ? ", above the precision target: raise round_depth_limit" : "")
+           << ")\n";
+    else
+        os << "  - step polynomial: g" << step.approx.g_n << "^" << step.approx.g_iters << " then f"
+           << step.approx.f_n << "^" << step.approx.f_iters << " (error " << step.step_error
+           << " per bit at |sim - tau| >= " << request.step_margin << ", x " << step_bits << " bits"
+           << (step.step_error * step_bits > STEP_ERROR_BUDGET ? ", over budget: raise step_margin" : "") << ")\n";
+    if (bootstrapping)
+        os << "  - bootstrapping: " << bootstrap.levels_after << " levels between refreshes, context depth "
+           << mult_depth << "\n";
+    else
+        os << "  - leveled: context depth " << mult_depth << "\n";
+    os << "  - scale 2^" << scale_bits << ", first modulus " << first_mod_bits << " bits\n";
+    os << "  - rotation keys: " << (request.rotation_keys == RotationKeyMode::Exact ? "exact" : "minimal");
+    return os.str();
+}
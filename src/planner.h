@@ -0,0 +1,69 @@
+// planner.h -- level-aware depth planner for the whole search circuit
+//
+// Given the search shape (DB size, dimension, layout, decision mode) and a precision
+// target, the planner picks the comparison polynomial, counts the exact multiplicative
+// depth of  similarity -> reduction -> compare,  decides whether bootstrapping is
+// needed, and emits the smallest CCParams that run the circuit. Threshold mode has no
+// tournament, so its step polynomial is planned on its own: precise enough that the
+// error of every step bit, summed over the bits of one probe, cannot flip the decision. Every level it does
+// not provision is one RNS tower less in every ciphertext and key.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "bootstrap.h"
+#include "compare.h"
+#include "openfhe/pke/openfhe.h"
+#include "reduce.h"
+#include "scores.h"
+
+struct PlanRequest {
+    size_t db_n = 0;
+    size_t dim = 0;
+    size_t probes = 1;                 // queries answered per pass over the DB
+    SimilarityLayout layout = SimilarityLayout::Diagonal;
+    DecisionMode mode = DecisionMode::Max;
+    ThresholdReduction reduction = ThresholdReduction::Count;
+    double precision = 1e-4;           // target worst-case error of the max polynomial
+    uint32_t round_depth_limit = 5;    // max levels one max evaluation may use (picks the polynomial)
+    double step_margin = 0.1;          // Threshold: smallest |sim - tau| the step polynomial must resolve
+    uint32_t scale_bits = 0;           // CKKS scale override in bits; 0 = derive from `precision`
+    bool allow_bootstrap = true;       // refresh instead of provisioning the whole circuit
+    uint32_t rounds_per_bootstrap = 2; // tournament rounds between refreshes
+    std::vector<uint32_t> bootstrap_level_budget = {3, 3};
+    RotationKeyMode rotation_keys = RotationKeyMode::Exact;  // key budget (see rotation.h); depth-neutral
+    lbcrypto::SecurityLevel security = lbcrypto::HEStd_128_classic;
+};
+
+struct CircuitPlan {
+    PlanRequest request;
+    SignPreset sign;                 // polynomial for max / compare (Max)
+    StepPreset step;                 // step polynomial (Threshold), planned from step_margin
+    size_t step_bits = 0;            // step bits reduced per probe (Threshold), padding included
+    uint32_t slots = 0;              // CKKS batch size (power of two)
+    size_t regions = 1;              // probes per query ciphertext (Packed; see packing.h)
+    size_t query_cts = 1;            // query ciphertexts per batch
+    uint32_t sim_depth = 0;          // similarity stage
+    uint32_t rounds = 0;             // sequential reduction rounds
+    uint32_t round_depth = 0;        // levels per round
+    uint32_t compare_depth = 0;      // compare (Max) or step (Threshold)
+    uint32_t mask_depth = 1;         // one-hot mask on the decision before decryption (keep_slots)
+    uint32_t circuit_depth = 0;      // everything, without refreshes
+    bool bootstrapping = false;
+    BootstrapConfig bootstrap;
+    uint32_t mult_depth = 0;         // depth the context is created with
+    uint32_t scale_bits = 0;
+    uint32_t first_mod_bits = 0;
+    uint32_t min_ring_dim = 0;       // lower bound on the ring dimension the context will get
+
+    std::string describe() const;    // multi-line summary for logs
+};
+
+// Throws std::invalid_argument for shapes the pipeline cannot run.
+CircuitPlan plan_circuit(const PlanRequest &req);
+
+// CCParams matching the plan: depth, scale, batch size, and bootstrapping requirements.
+lbcrypto::CCParams<lbcrypto::CryptoContextCKKSRNS> make_cc_params(const CircuitPlan &plan);
@@ -0,0 +1,102 @@
+// precision.cpp -- per-stage noise/precision tracking (see precision.h)
+
+#include "precision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using namespace lbcrypto;
+
+static const double SIGMA = 3.19;  // OpenFHE's default error distribution width
+
+SlotValues dense_slots(const std::vector<double> &values) {
+    SlotValues out(values.size());
+    for (size_t i = 0; i < values.size(); i++) out[i] = {i, values[i]};
+    return out;
+}
+
+SlotValues score_slots(const EncryptedScores &scores, size_t ct_index, const double *plain, size_t slot_offset) {
+    SlotValues out;
+    const size_t first = ct_index * scores.per_ct;
+    for (size_t i = first; i < std::min(first + scores.per_ct, scores.count); i++)
+        out.push_back({slot_offset + (i - first) * scores.stride, plain[i]});
+    return out;
+}
+
+PrecisionTracker::PrecisionTracker(CryptoContext<DCRTPoly> cc, uint32_t total_depth)
+    : cc_(std::move(cc)), total_depth_(total_depth) {}
+
+void PrecisionTracker::enable_oracle(const PrivateKey<DCRTPoly> &sk) {
+    CryptoContext<DCRTPoly> cc = cc_;
+    decrypt_ = [cc, sk](const Ciphertext<DCRTPoly> &ct) {
+        Plaintext pt;
+        cc->Decrypt(sk, ct, &pt);
+        return pt;
+    };
+}
+
+double PrecisionTracker::estimate_error(const Ciphertext<DCRTPoly> &ct) const {
+    const double n = cc_->GetRingDimension();
+    const double h = 2.0 * n / 3.0;  // expected Hamming weight of a uniform ternary secret
+    const double b_clean = 8.0 * std::sqrt(2.0) * SIGMA * n + 6.0 * SIGMA * std::sqrt(n) + 16.0 * SIGMA * std::sqrt(h * n);
+    const double b_scale = std::sqrt(n / 3.0) * (3.0 + 8.0 * std::sqrt(h));
+    const double levels = ct->GetLevel() + (ct->GetNoiseScaleDeg() - 1);
+    return (b_clean + levels * b_scale) / ct->GetScalingFactor();
+}
+
+void PrecisionTracker::track(const std::string &stage, const Ciphertext<DCRTPoly> &ct, const SlotValues &expected) {
+    auto it = std::find_if(samples_.begin(), samples_.end(), [&](const PrecisionSample &s) { return s.stage == stage; });
+    if (it == samples_.end()) {
+        PrecisionSample fresh;
+        fresh.stage = stage;
+        fresh.remaining = total_depth_;
+        fresh.openfhe_log_precision = INFINITY;
+        samples_.push_back(fresh);
+        it = samples_.end() - 1;
+    }
+    const uint32_t used = static_cast<uint32_t>(ct->GetLevel() + (ct->GetNoiseScaleDeg() - 1));
+    it->ciphertexts++;
+    it->level = std::max(it->level, static_cast<uint32_t>(ct->GetLevel()));
+    it->remaining = std::min(it->remaining, used >= total_depth_ ? 0u : total_depth_ - used);
+    it->log2_scale = std::log2(ct->GetScalingFactor());
+    it->est_error = std::max(it->est_error, estimate_error(ct));
+
+    if (!decrypt_ || expected.empty()) return;
+    double err = INFINITY;
+    try {
+        Plaintext pt = decrypt_(ct);
+        const std::vector<double> values = pt->GetRealPackedValue();
+        err = 0;
+        for (const auto &e : expected)
+            err = std::max(err, e.first < values.size() ? std::abs(values[e.first] - e.second) : INFINITY);
+        it->openfhe_log_precision = std::min(it->openfhe_log_precision, pt->GetLogPrecision());
+    } catch (const std::exception &) {
+        // OpenFHE refuses to decode once the noise swamps the message; that is a measurement too
+    }
+    it->measured_error = std::max(it->measured_error, err);
+}
+
+std::string PrecisionTracker::report(const std::string &target_stage, double target) const {
+    std::ostringstream os;
+    const PrecisionSample *checked = nullptr;
+    for (const auto &s : samples_) {
+        os << "  - " << s.stage << " (" << s.ciphertexts << " ct): level " << s.level << ", " << s.remaining
+           << " left, scale 2^" << s.log2_scale << ", est. error " << s.est_error;
+        if (s.measured_error >= 0) {
+            os << ", measured " << s.measured_error << " (" << -std::log2(s.measured_error) << " bits";
+            if (std::isfinite(s.openfhe_log_precision)) os << ", OpenFHE " << s.openfhe_log_precision;
+            os << ")";
+            if (s.stage == target_stage) checked = &s;
+        }
+        os << "\n";
+    }
+    if (checked) {
+        const double headroom = std::log2(target) - std::log2(checked->measured_error);
+        os << "  - " << target_stage << " vs target " << target << ": "
+           << (checked->measured_error < target ? "PASS" : "FAIL") << ", headroom " << headroom << " bits";
+    } else {
+        os << "  - " << target_stage << " not measured (the oracle is off)";
+    }
+    return os.str();
+}
@@ -0,0 +1,94 @@
+// precision.h -- per-stage noise/precision tracking with an optional decrypt oracle
+//
+// Debug mode: after each pipeline stage the driver hands the stage's ciphertexts to
+// a PrecisionTracker, which records their level, the levels left in the context,
+// log2 of the scaling factor and a model estimate of the absolute slot error that
+// CKKS arithmetic has added so far. The model (Cheon-Kim-Kim-Song bounds at the
+// context's ring dimension and scale) charges the fresh-encryption noise once and
+// one rescale rounding term per consumed level:
+//
+//     est = (B_clean + level * B_scale) / scale
+//     B_clean = 8 sqrt(2) sigma N + 6 sigma sqrt(N) + 16 sigma sqrt(h N)
+//     B_scale = sqrt(N / 3) (3 + 8 sqrt(h)),  sigma = 3.19, h = 2N/3
+//
+// It ignores the approximation error of the sign polynomials (SignPreset::max_error
+// covers that) and how polynomial evaluation amplifies earlier error, and it cannot
+// see bootstrapping (a refreshed ciphertext looks fresh). It is a floor to compare
+// scale choices against, not a bound.
+//
+// Test mode adds the oracle: with the secret key the tracker decrypts each tracked
+// ciphertext and compares chosen slots against their plaintext-computed values,
+// giving the measured error per stage. That is what tells whether SCALE_BITS or
+// the depth can go down and still meet the precision target. The oracle reveals
+// intermediate values to the key holder, so it is for tests and tuning only.
+//
+// Samples from repeated stages (one per query or score ciphertext) are folded into
+// one row per stage keeping the worst case. Call from the driving thread.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "openfhe/pke/openfhe.h"
+#include "scores.h"
+
+// (slot index, expected plaintext value) pairs checked by the oracle.
+using SlotValues = std::vector<std::pair<size_t, double>>;
+
+// Slots 0 .. values.size()-1 expected to hold `values`.
+SlotValues dense_slots(const std::vector<double> &values);
+
+// Slots of ciphertext ct_index of `scores` expected to hold plain[i] (scores.h layout;
+// plain holds scores.count values), shifted by slot_offset (e.g. a packed probe region).
+SlotValues score_slots(const EncryptedScores &scores, size_t ct_index, const double *plain, size_t slot_offset = 0);
+
+struct PrecisionSample {
+    std::string stage;
+    size_t ciphertexts = 0;       // ciphertexts folded into this row
+    uint32_t level = 0;           // highest level (rescales applied) seen
+    uint32_t remaining = 0;       // fewest levels left in the context
+    double log2_scale = 0;        // log2 of the scaling factor of the last ciphertext
+    double est_error = 0;         // worst model estimate (see above)
+    double measured_error = -1;   // oracle: worst max |decrypted - expected|; -1 if not measured
+    double openfhe_log_precision = 0;  // oracle: lowest Plaintext::GetLogPrecision() of the decryptions
+};
+
+class PrecisionTracker {
+public:
+    // total_depth: multiplicative depth of the context (for the levels-left column).
+    PrecisionTracker(lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc, uint32_t total_depth);
+
+    using Decryptor = std::function<lbcrypto::Plaintext(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &)>;
+
+    // Turns on the decrypt oracle for every later track() call, decrypting with `sk`.
+    // Single-key mode only: with the key split across parties the oracle would have them
+    // decrypt every intermediate for the server, which is exactly what they must refuse.
+    void enable_oracle(const lbcrypto::PrivateKey<lbcrypto::DCRTPoly> &sk);
+    bool oracle() const { return static_cast<bool>(decrypt_); }
+
+    // Records ct as an output of `stage`. With the oracle on, decrypts ct and measures
+    // the error on `expected` (no measurement when it is empty).
+    void track(const std::string &stage, const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &ct,
+               const SlotValues &expected = {});
+
+    // Model error estimate for ct, in absolute slot units.
+    double estimate_error(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &ct) const;
+
+    // Stages in first-seen order.
+    const std::vector<PrecisionSample> &samples() const { return samples_; }
+
+    // One line per stage; with the oracle on, ends with whether the measured error of
+    // `target_stage` meets `target` and the bits of headroom (positive = bits to spare).
+    std::string report(const std::string &target_stage, double target) const;
+
+private:
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc_;
+    uint32_t total_depth_;
+    Decryptor decrypt_;
+    std::vector<PrecisionSample> samples_;
+};
@@ -0,0 +1,140 @@
+// reduce.cpp -- encrypted reductions over EncryptedScores (see reduce.h)
+
+#include "reduce.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "parallel.h"
+#include "rotation.h"
+
+using namespace lbcrypto;
+
+static size_t next_power_of_two(size_t x) {
+    size_t p = 1;
+    while (p < x) p <<= 1;
+    return p;
+}
+
+static Ciphertext<DCRTPoly> refreshed(LevelRefresher *refresh, const Ciphertext<DCRTPoly> &ct, uint32_t needed) {
+    return refresh ? refresh->ensure(ct, needed) : ct;
+}
+
+static uint32_t ceil_log2(size_t x) {
+    uint32_t r = 0;
+    while ((size_t(1) << r) < x) r++;
+    return r;
+}
+
+// One tournament round: combine(cts[2i], cts[2i+1]) for every pair, all pairs in
+// parallel. parallel_for returns only once every pair is done, which is the barrier
+// between rounds. An odd trailing ciphertext is moved into the next round untouched.
+template <class Combine>
+static void pairwise_round(std::vector<Ciphertext<DCRTPoly>> &cts, Combine combine) {
+    const size_t pairs = cts.size() / 2;
+    std::vector<Ciphertext<DCRTPoly>> next(pairs + cts.size() % 2);
+    parallel_for(pairs, [&](size_t i) { next[i] = combine(cts[2 * i], cts[2 * i + 1]); });
+    if (cts.size() % 2 == 1) next.back() = std::move(cts.back());
+    cts.swap(next);
+}
+
+size_t tournament_span(size_t count, size_t per_ct) {
+    return next_power_of_two(std::min(count, per_ct));
+}
+
+uint32_t tournament_rounds(size_t count, size_t per_ct) {
+    size_t num_cts = (count + per_ct - 1) / per_ct;
+    return ceil_log2(next_power_of_two(num_cts)) + ceil_log2(tournament_span(count, per_ct));
+}
+
+std::vector<int32_t> slot_tournament_rotations(size_t span, size_t stride) {
+    std::vector<int32_t> idx;
+    for (size_t k = span / 2; k >= 1; k /= 2) idx.push_back(static_cast<int32_t>(k * stride));
+    return idx;
+}
+
+Ciphertext<DCRTPoly> ciphertext_tournament_max(const CryptoContext<DCRTPoly> &cc,
+                                               std::vector<Ciphertext<DCRTPoly>> cts, const SignApprox &approx,
+                                               LevelRefresher *refresh) {
+    if (cts.empty()) throw std::invalid_argument("ciphertext_tournament_max: no ciphertexts");
+    while (cts.size() > 1) {
+        pairwise_round(cts, [&](const Ciphertext<DCRTPoly> &a, const Ciphertext<DCRTPoly> &b) {
+            return eval_max(cc, refreshed(refresh, a, approx.max_depth()), refreshed(refresh, b, approx.max_depth()),
+                            approx);
+        });
+    }
+    return cts[0];
+}
+
+Ciphertext<DCRTPoly> slot_tournament_max(const CryptoContext<DCRTPoly> &cc, const Ciphertext<DCRTPoly> &ct,
+                                         size_t span, size_t stride, const SignApprox &approx,
+                                         LevelRefresher *refresh) {
+    if (span == 0 || (span & (span - 1)) != 0)
+        throw std::invalid_argument("slot_tournament_max: span must be a power of two");
+    Ciphertext<DCRTPoly> acc = ct;
+    for (int32_t r : slot_tournament_rotations(span, stride)) {
+        acc = refreshed(refresh, acc, approx.max_depth());
+        acc = eval_max(cc, acc, cc->EvalAtIndex(acc, r), approx);
+    }
+    return acc;
+}
+
+Ciphertext<DCRTPoly> reduce_max(const CryptoContext<DCRTPoly> &cc, const EncryptedScores &scores,
+                                const SignApprox &approx, LevelRefresher *refresh) {
+    Ciphertext<DCRTPoly> merged = ciphertext_tournament_max(cc, scores.cts, approx, refresh);
+    return slot_tournament_max(cc, merged, tournament_span(scores.count, scores.per_ct), scores.stride, approx,
+                               refresh);
+}
+
+std::vector<int32_t> threshold_reduce_rotations(size_t span, size_t stride, ThresholdReduction reduction,
+                                                size_t radix) {
+    if (reduction == ThresholdReduction::Count) return fold_sum_rotations(span, stride, radix);
+    return slot_tournament_rotations(span, stride);
+}
+
+uint32_t threshold_reduce_depth(size_t count, size_t per_ct, ThresholdReduction reduction) {
+    return reduction == ThresholdReduction::Count ? 0 : tournament_rounds(count, per_ct);
+}
+
+Ciphertext<DCRTPoly> threshold_reduce(const CryptoContext<DCRTPoly> &cc, const EncryptedScores &scores,
+                                      double tau, const SignApprox &approx, ThresholdReduction reduction,
+                                      LevelRefresher *refresh, size_t radix) {
+    if (scores.cts.empty()) throw std::invalid_argument("threshold_reduce: no score ciphertexts");
+    const size_t span = tournament_span(scores.count, scores.per_ct);
+    if (reduction == ThresholdReduction::Count) {
+        // padding sits at SCORE_FLOOR < tau, so its step bit is 0 and drops out of the sum
+        std::vector<Ciphertext<DCRTPoly>> bits(scores.cts.size());
+        parallel_for(bits.size(), [&](size_t c) {
+            bits[c] = eval_at_least(cc, refreshed(refresh, scores.cts[c], approx.depth()), tau, approx);
+        });
+        Ciphertext<DCRTPoly> acc = cc->EvalAddMany(bits);
+        return fold_sum(cc, acc, span, scores.stride, radix);
+    }
+    // all-below: bits 1[score < tau] multiplied together; padding contributes 1
+    std::vector<Ciphertext<DCRTPoly>> bits(scores.cts.size());
+    parallel_for(bits.size(), [&](size_t c) {
+        bits[c] = eval_less_than(cc, refreshed(refresh, scores.cts[c], approx.depth()), tau, approx);
+    });
+    while (bits.size() > 1) {
+        pairwise_round(bits, [&](const Ciphertext<DCRTPoly> &a, const Ciphertext<DCRTPoly> &b) {
+            return cc->EvalMult(refreshed(refresh, a, 1), refreshed(refresh, b, 1));
+        });
+    }
+    Ciphertext<DCRTPoly> acc = bits[0];
+    for (int32_t r : slot_tournament_rotations(span, scores.stride)) {
+        acc = refreshed(refresh, acc, 1);
+        acc = cc->EvalMult(acc, cc->EvalAtIndex(acc, r));
+    }
+    return acc;
+}
+
+Ciphertext<DCRTPoly> keep_slots(const CryptoContext<DCRTPoly> &cc, const Ciphertext<DCRTPoly> &ct,
+                                const std::vector<size_t> &keep, size_t slots) {
+    std::vector<double> mask(slots, 0.0);
+    for (size_t s : keep) {
+        if (s >= slots) throw std::invalid_argument("keep_slots: slot out of range");
+        mask[s] = 1.0;
+    }
+    return cc->EvalMult(ct, cc->MakeCKKSPackedPlaintext(mask));
+}
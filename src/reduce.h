@@ -0,0 +1,97 @@
+// reduce.h -- encrypted reductions over EncryptedScores
+//
+// The maximum is found in two phases:
+//  1. ciphertext tournament: score ciphertexts are paired slot-wise until one is left
+//     (only needed when the DB spans several ciphertexts),
+//  2. in-slot tournament: the surviving ciphertext is rotated by span/2, span/4, ...
+//     (times the score stride) and max'ed with itself, so slot 0 ends up with the max
+//     of every score slot.
+// Phase 2 costs log2(span) max evaluations on whole ciphertexts, instead of one max per
+// pair of scores.
+//
+// When only the decision isUnique = (maxSim < tau) is needed, the maximum can be skipped
+// altogether: one step polynomial per score ciphertext turns every score into a bit,
+// and a rotate-and-add (count) or rotate-and-multiply (all-below) reduction combines
+// the bits. That is one sign evaluation instead of log2(N) sequential max evaluations.
+//
+// Independent work inside a round (the pairs of a ciphertext tournament round, the
+// step polynomial of every score ciphertext) runs on parallel_for; rounds themselves
+// are sequential, with the end of each parallel_for acting as the barrier.
+//
+// Every reduction takes an optional LevelRefresher: before each step the working
+// ciphertext is checked against the levels the step needs and bootstrapped if short.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bootstrap.h"
+#include "compare.h"
+#include "openfhe/pke/openfhe.h"
+#include "rotation.h"
+#include "scores.h"
+
+// How the demo turns scores into the isUnique decision.
+enum class DecisionMode {
+    Max,        // tournament max, then encrypted compare against tau
+    Threshold,  // step per score + reduction, no maximum computed
+};
+
+// Reduction applied to the per-score step bits in DecisionMode::Threshold.
+enum class ThresholdReduction {
+    Count,      // slot 0 = #{i : score_i >= tau}; depth = sign depth, reveals the count on decryption
+    AllBelow,   // slot 0 = prod_i 1[score_i < tau] = isUnique; sign depth + one level per round
+};
+
+// Slot span the in-slot tournament must cover: per-ciphertext scores rounded up to a
+// power of two.
+size_t tournament_span(size_t count, size_t per_ct);
+
+// Sequential max evaluations on the critical path (ciphertext + in-slot rounds).
+uint32_t tournament_rounds(size_t count, size_t per_ct);
+
+// Rotation indices used by slot_tournament_max(span, stride).
+std::vector<int32_t> slot_tournament_rotations(size_t span, size_t stride);
+
+// Slot-wise max over a list of ciphertexts, the pairs of each round evaluated in
+// parallel; an odd ciphertext is moved (not copied) into the next round.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> ciphertext_tournament_max(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+    std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> cts, const SignApprox &approx,
+    LevelRefresher *refresh = nullptr);
+
+// After the call slot 0 holds the max of slots 0, stride, ..., (span-1)*stride.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> slot_tournament_max(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                             const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &ct,
+                                                             size_t span, size_t stride, const SignApprox &approx,
+                                                             LevelRefresher *refresh = nullptr);
+
+// Rotation indices used by threshold_reduce(span, stride, radix) (either reduction).
+std::vector<int32_t> threshold_reduce_rotations(size_t span, size_t stride, ThresholdReduction reduction,
+                                                size_t radix = FOLD_RADIX);
+
+// Levels consumed by threshold_reduce on top of the step polynomial.
+uint32_t threshold_reduce_depth(size_t count, size_t per_ct, ThresholdReduction reduction);
+
+// Step per score ciphertext, then the reduction; the result lives in slot 0. `radix` is
+// the fold radix of the Count reduction (see RotationKeyMode).
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> threshold_reduce(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                          const EncryptedScores &scores, double tau,
+                                                          const SignApprox &approx, ThresholdReduction reduction,
+                                                          LevelRefresher *refresh = nullptr,
+                                                          size_t radix = FOLD_RADIX);
+
+// Zeroes every slot of ct (`slots` wide) except those listed in `keep` with one plaintext product (one
+// level). The decision ciphertexts go through it before decryption: the other slots hold
+// partial tournament or fold results (maxima of subsets of scores, partial counts), and
+// decrypting them would reveal more than one value per probe.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> keep_slots(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                    const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &ct,
+                                                    const std::vector<size_t> &keep, size_t slots);
+
+// Both phases: slot 0 of the result holds max_i cos(q, v_i).
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> reduce_max(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                    const EncryptedScores &scores, const SignApprox &approx,
+                                                    LevelRefresher *refresh = nullptr);
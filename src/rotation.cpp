@@ -0,0 +1,65 @@
+// rotation.cpp -- hoisted rotations and rotate-and-add folds (see rotation.h)
+
+#include "rotation.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace lbcrypto;
+
+std::vector<Ciphertext<DCRTPoly>> hoisted_rotations(const CryptoContext<DCRTPoly> &cc,
+                                                    const Ciphertext<DCRTPoly> &ct,
+                                                    const std::vector<int32_t> &indices) {
+    const uint32_t m = cc->GetCyclotomicOrder();
+    const int32_t slots = static_cast<int32_t>(ct->GetSlots());
+    auto precomp = cc->EvalFastRotationPrecompute(ct);
+    std::vector<Ciphertext<DCRTPoly>> out;
+    out.reserve(indices.size());
+    for (int32_t idx : indices) {
+        if (idx == 0) {
+            out.push_back(ct);
+            continue;
+        }
+        // EvalFastRotation takes an unsigned index: map right rotations onto left ones
+        int32_t left = ((idx % slots) + slots) % slots;
+        out.push_back(cc->EvalFastRotation(ct, static_cast<uint32_t>(left), m, precomp));
+    }
+    return out;
+}
+
+// Calls visit(step, digits) for every stage of the fold; the stage rotates by
+// step, 2*step, ..., (digits-1)*step.
+template <class Visit>
+static void for_each_fold_stage(size_t span, size_t stride, size_t radix, Visit visit) {
+    if (span == 0 || (span & (span - 1)) != 0)
+        throw std::invalid_argument("fold_sum: span must be a power of two");
+    if (radix < 2 || (radix & (radix - 1)) != 0)
+        throw std::invalid_argument("fold_sum: radix must be a power of two >= 2");
+    size_t step = stride;
+    for (size_t done = 1; done < span;) {
+        size_t digits = std::min(radix, span / done);
+        visit(step, digits);
+        step *= digits;
+        done *= digits;
+    }
+}
+
+Ciphertext<DCRTPoly> fold_sum(const CryptoContext<DCRTPoly> &cc, const Ciphertext<DCRTPoly> &ct,
+                              size_t span, size_t stride, size_t radix) {
+    Ciphertext<DCRTPoly> acc = ct;
+    for_each_fold_stage(span, stride, radix, [&](size_t step, size_t digits) {
+        std::vector<int32_t> idx;
+        for (size_t d = 1; d < digits; d++) idx.push_back(static_cast<int32_t>(d * step));
+        std::vector<Ciphertext<DCRTPoly>> rots = hoisted_rotations(cc, acc, idx);
+        for (const auto &r : rots) cc->EvalAddInPlace(acc, r);
+    });
+    return acc;
+}
+
+std::vector<int32_t> fold_sum_rotations(size_t span, size_t stride, size_t radix) {
+    std::vector<int32_t> idx;
+    for_each_fold_stage(span, stride, radix, [&](size_t step, size_t digits) {
+        for (size_t d = 1; d < digits; d++) idx.push_back(static_cast<int32_t>(d * step));
+    });
+    return idx;
+}
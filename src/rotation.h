@@ -0,0 +1,49 @@
+// rotation.h -- hoisted rotations and rotate-and-add folds
+//
+// A key switch first decomposes the ciphertext into digits (ModUp) and then takes an
+// inner product with the rotation key. When several rotations are applied to the same
+// ciphertext, EvalFastRotationPrecompute does the decomposition once and each
+// EvalFastRotation only pays for the inner product.
+//
+// fold_sum uses this for rotate-and-add reductions: instead of log2(span) sequential
+// rotations (one decomposition each), every stage rotates the current accumulator by
+// radix-1 multiples of the step from a single decomposition, so a radix-4 fold needs
+// log4(span) decompositions -- half of the radix-2 count.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "openfhe/pke/openfhe.h"
+
+// Default fold radix: halves decompositions vs. radix 2 for 1.5x the inner products.
+constexpr size_t FOLD_RADIX = 4;
+
+// Rotation keys are the largest objects a worker holds (tens of MB each at N = 2^16),
+// so the circuit can be built for either of two key budgets:
+//   Exact:   one key per distinct index of the fastest circuit (hoisted baby steps,
+//            radix-4 folds, one key per giant step),
+//   Minimal: folds use radix 2 and the matvec evaluates giant steps Horner-style and
+//            baby steps as repeated rotations by 1, so every index is either a power of
+//            two (times the score stride) or the BSGS baby width. Same number of
+//            rotations, no hoisting, far fewer keys.
+enum class RotationKeyMode { Exact, Minimal };
+
+// Fold radix a circuit built for `mode` uses.
+inline size_t fold_radix(RotationKeyMode mode) { return mode == RotationKeyMode::Exact ? FOLD_RADIX : 2; }
+
+// rot(ct, i) for every i in indices, sharing one digit decomposition. Index 0 returns ct.
+std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> hoisted_rotations(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+    const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &ct, const std::vector<int32_t> &indices);
+
+// sum_{i < span} rot(ct, i * stride): afterwards slot s holds ct[s] + ct[s+stride] + ...
+// span must be a power of two.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> fold_sum(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                  const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &ct,
+                                                  size_t span, size_t stride = 1, size_t radix = FOLD_RADIX);
+
+// Rotation indices fold_sum(span, stride, radix) will request.
+std::vector<int32_t> fold_sum_rotations(size_t span, size_t stride = 1, size_t radix = FOLD_RADIX);
@@ -0,0 +1,32 @@
+// rotation_keys.cpp -- rotation key set derived from the planned circuit (see rotation_keys.h)
+
+#include "rotation_keys.h"
+
+#include <algorithm>
+
+#include "matvec.h"
+#include "packing.h"
+#include "reduce.h"
+
+std::vector<int32_t> circuit_rotations(const CircuitPlan &plan) {
+    const PlanRequest &req = plan.request;
+    std::vector<int32_t> idx;
+    size_t span, stride;
+    if (req.layout == SimilarityLayout::Packed) {
+        PackedLayout layout = make_packed_layout(req.db_n, req.dim, plan.slots, req.rotation_keys, plan.regions);
+        idx = block_sum_rotations(layout);
+        span = tournament_span(req.db_n, layout.per_ct);
+        stride = req.dim;
+    } else {
+        idx = matvec_rotations(make_diagonal_layout(req.db_n, req.dim, plan.slots, req.rotation_keys));
+        span = tournament_span(req.db_n, plan.slots);
+        stride = 1;
+    }
+    std::vector<int32_t> reduce = req.mode == DecisionMode::Max
+        ? slot_tournament_rotations(span, stride)
+        : threshold_reduce_rotations(span, stride, req.reduction, fold_radix(req.rotation_keys));
+    idx.insert(idx.end(), reduce.begin(), reduce.end());
+    std::sort(idx.begin(), idx.end());
+    idx.erase(std::unique(idx.begin(), idx.end()), idx.end());
+    return idx;
+}
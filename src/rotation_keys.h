@@ -0,0 +1,20 @@
+// rotation_keys.h -- rotation key set derived from the planned circuit
+//
+// Every stage that rotates exposes the indices it will request (block_sum_rotations,
+// matvec_rotations, slot_tournament_rotations, threshold_reduce_rotations).
+// circuit_rotations() walks the stages the plan actually runs, in the key budget the
+// plan asks for, and returns their union -- exactly the set EvalAtIndexKeyGen has to
+// generate, nothing hard-coded. The pipeline never calls EvalSum (folds are explicit
+// rotate-and-add), so no EvalSumKeyGen keys are needed on top.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "planner.h"
+
+// Sorted, de-duplicated rotation indices of the circuit described by `plan`, with
+// layouts built by make_packed_layout / make_diagonal_layout for plan.slots,
+// plan.regions and plan.request.rotation_keys.
+std::vector<int32_t> circuit_rotations(const CircuitPlan &plan);
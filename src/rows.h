@@ -0,0 +1,37 @@
+// rows.h -- non-owning view of consecutive DB rows
+//
+// The gallery is never held as one object: the loader (loader.h) fills a chunk Matrix
+// (matrix.h) with consecutive, normalized rows, the plaintext baseline (kernels.h) scans
+// them and the encoders (packing.h, matvec.h) build the ciphertexts those rows fall into.
+// A RowView points into the Matrix rather than copying it and addresses rows by gallery
+// index, so an encoder can work on any chunk that starts and ends on one of its
+// ciphertext boundaries.
+
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+
+#include "matrix.h"
+
+template <class T>
+struct RowView {
+    const T *data = nullptr;  // first row
+    size_t first = 0;         // gallery index of the first row
+    size_t rows = 0;
+    size_t dim = 0;
+    size_t stride = 0;        // distance between rows, in values (Matrix::ld())
+
+    size_t end() const { return first + rows; }
+    // Row with gallery index i, first <= i < end().
+    const T *row(size_t i) const { return data + (i - first) * stride; }
+};
+using RowBlock = RowView<double>;  // what the CKKS encoders take
+
+// Rows [row0, row0 + n) of row-major `m` as gallery rows first .. first + n - 1.
+template <class T>
+RowView<T> row_block(const Matrix<T> &m, size_t first, size_t row0, size_t n) {
+    if (m.order() != MatrixOrder::RowMajor || row0 > m.rows() || n > m.rows() - row0)
+        throw std::invalid_argument("row_block: rows outside the row-major matrix");
+    return RowView<T>{m.row(row0), first, n, m.cols(), m.ld()};
+}
@@ -0,0 +1,27 @@
+// scores.h -- where encrypted similarity scores live inside CKKS slots
+//
+// Every similarity stage produces one or more ciphertexts whose slots hold
+// cos(q, v_i). Score i lives in ciphertext i / per_ct, slot (i % per_ct) * stride.
+// All other slots hold SCORE_FLOOR so that reductions (max, threshold counts)
+// can run over whole ciphertexts without ever picking up a padding slot.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "openfhe/pke/openfhe.h"
+
+// Cosines live in [-1, 1]; padding sits at the bottom of that range so it never
+// wins a max and never crosses a positive threshold.
+constexpr double SCORE_FLOOR = -1.0;
+
+// How the similarity stage lays out the DB (packing.h / matvec.h).
+enum class SimilarityLayout { Packed, Diagonal };
+
+struct EncryptedScores {
+    std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> cts;
+    size_t count = 0;   // number of real scores
+    size_t per_ct = 0;  // scores held by each ciphertext
+    size_t stride = 1;  // slot distance between neighbouring scores
+};
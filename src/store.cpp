@@ -0,0 +1,201 @@
+// store.cpp -- persistent encrypted DB store (see store.h)
+
+#include "store.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ciphertext-ser.h"
+#include "cryptocontext-ser.h"
+#include "scheme/ckksrns/ckksrns-ser.h"
+
+using namespace lbcrypto;
+
+static const char STORE_MAGIC[8] = {'M', 'R', 'C', 'L', 'D', 'B', '0', '3'};
+
+// Read-only istream source over a byte range of the mapping (no copy).
+struct MemoryBuf : std::streambuf {
+    MemoryBuf(const char *p, size_t n) {
+        char *b = const_cast<char *>(p);
+        setg(b, b, b + n);
+    }
+};
+
+template <class T>
+static void put(std::ostream &os, const T &v) {
+    os.write(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+// Bounds-checked cursor over the mapped header.
+struct Reader {
+    const char *p;
+    const char *end;
+
+    template <class T>
+    T get() {
+        T v;
+        need(sizeof(T));
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+    void need(size_t n) const {
+        if (static_cast<size_t>(end - p) < n) throw std::runtime_error("EncryptedStore: truncated header");
+    }
+};
+
+uint64_t context_hash(const CryptoContext<DCRTPoly> &cc) {
+    std::stringstream ss;
+    Serial::Serialize(cc, ss, SerType::BINARY);
+    const std::string bytes = ss.str();
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : bytes) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void write_store(const std::string &path, const CryptoContext<DCRTPoly> &cc, const std::string &gallery,
+                 SimilarityLayout layout, size_t count, size_t dim, size_t slots, size_t regions,
+                 const std::vector<Ciphertext<DCRTPoly>> &shards) {
+    if (shards.empty()) throw std::invalid_argument("write_store: no shards");
+    const std::string tmp = path + ".tmp";
+    std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+    if (!os) throw std::runtime_error("write_store: cannot create " + tmp);
+
+    const std::string &tag = shards[0]->GetKeyTag();
+    os.write(STORE_MAGIC, sizeof(STORE_MAGIC));
+    put<uint32_t>(os, static_cast<uint32_t>(layout));
+    put<uint32_t>(os, static_cast<uint32_t>(shards[0]->GetLevel()));
+    put<uint64_t>(os, count);
+    put<uint64_t>(os, dim);
+    put<uint64_t>(os, slots);
+    put<uint64_t>(os, regions);
+    put<double>(os, shards[0]->GetScalingFactor());
+    put<uint64_t>(os, context_hash(cc));
+    put<uint64_t>(os, shards.size());
+    put<uint32_t>(os, static_cast<uint32_t>(tag.size()));
+    os.write(tag.data(), tag.size());
+    put<uint32_t>(os, static_cast<uint32_t>(gallery.size()));
+    os.write(gallery.data(), gallery.size());
+
+    // shard table is filled in once the blob offsets are known
+    const std::streampos table_pos = os.tellp();
+    std::vector<uint64_t> table(2 * shards.size(), 0);
+    os.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(uint64_t));
+    for (size_t i = 0; i < shards.size(); i++) {
+        const std::streampos start = os.tellp();
+        Serial::Serialize(shards[i], os, SerType::BINARY);
+        table[2 * i] = static_cast<uint64_t>(start);
+        table[2 * i + 1] = static_cast<uint64_t>(os.tellp() - start);
+    }
+    os.seekp(table_pos);
+    os.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(uint64_t));
+    os.close();
+    if (!os) throw std::runtime_error("write_store: failed writing " + tmp);
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) throw std::runtime_error("write_store: cannot rename to " + path);
+}
+
+EncryptedStore::EncryptedStore(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("EncryptedStore: cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("EncryptedStore: cannot stat " + path);
+    }
+    length_ = static_cast<size_t>(st.st_size);
+    void *m = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // the mapping keeps the file alive
+    if (m == MAP_FAILED) throw std::runtime_error("EncryptedStore: cannot mmap " + path);
+    data_ = static_cast<const char *>(m);
+
+    try {
+        Reader r{data_, data_ + length_};
+        r.need(sizeof(STORE_MAGIC));
+        if (std::memcmp(r.p, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0)
+            throw std::runtime_error("EncryptedStore: " + path + " is not an encrypted DB store");
+        r.p += sizeof(STORE_MAGIC);
+        header_.layout = static_cast<SimilarityLayout>(r.get<uint32_t>());
+        header_.level = r.get<uint32_t>();
+        header_.count = r.get<uint64_t>();
+        header_.dim = r.get<uint64_t>();
+        header_.slots = r.get<uint64_t>();
+        header_.regions = r.get<uint64_t>();
+        header_.scale = r.get<double>();
+        header_.cc_hash = r.get<uint64_t>();
+        header_.shards = r.get<uint64_t>();
+        uint32_t tag_len = r.get<uint32_t>();
+        r.need(tag_len);
+        header_.key_tag.assign(r.p, tag_len);
+        r.p += tag_len;
+        uint32_t gallery_len = r.get<uint32_t>();
+        r.need(gallery_len);
+        header_.gallery.assign(r.p, gallery_len);
+        r.p += gallery_len;
+
+        table_.resize(header_.shards);
+        for (auto &e : table_) {
+            e.offset = r.get<uint64_t>();
+            e.size = r.get<uint64_t>();
+            if (e.offset > length_ || e.size > length_ - e.offset)
+                throw std::runtime_error("EncryptedStore: shard outside " + path);
+        }
+    } catch (...) {
+        ::munmap(const_cast<char *>(data_), length_);
+        throw;
+    }
+    loaded_.reset(new std::once_flag[header_.shards]);
+    cache_.resize(header_.shards);
+}
+
+EncryptedStore::~EncryptedStore() {
+    if (data_) ::munmap(const_cast<char *>(data_), length_);
+}
+
+bool EncryptedStore::matches(const CryptoContext<DCRTPoly> &cc, const PublicKey<DCRTPoly> &pk,
+                             const std::string &gallery, SimilarityLayout layout, size_t count, size_t dim,
+                             size_t slots, size_t regions) const {
+    return header_.layout == layout && header_.count == count && header_.dim == dim && header_.slots == slots &&
+           header_.regions == regions && header_.gallery == gallery &&
+           header_.key_tag == pk->GetKeyTag() && header_.cc_hash == context_hash(cc);
+}
+
+Ciphertext<DCRTPoly> EncryptedStore::shard(size_t i) const {
+    if (i >= table_.size()) throw std::out_of_range("EncryptedStore::shard: index out of range");
+    std::call_once(loaded_[i], [&] {
+        MemoryBuf buf(data_ + table_[i].offset, table_[i].size);
+        std::istream is(&buf);
+        Ciphertext<DCRTPoly> ct;
+        Serial::Deserialize(ct, is, SerType::BINARY);
+        if (!ct) throw std::runtime_error("EncryptedStore::shard: cannot deserialize shard " + std::to_string(i));
+        cache_[i] = ct;
+    });
+    return cache_[i];
+}
+
+std::unique_ptr<EncryptedStore> open_matching_store(const std::string &path, const CryptoContext<DCRTPoly> &cc,
+                                                    const PublicKey<DCRTPoly> &pk, const std::string &gallery,
+                                                    SimilarityLayout layout, size_t count, size_t dim, size_t slots,
+                                                    size_t regions) {
+    if (::access(path.c_str(), R_OK) != 0) return nullptr;
+    try {
+        std::unique_ptr<EncryptedStore> store(new EncryptedStore(path));
+        if (store->matches(cc, pk, gallery, layout, count, dim, slots, regions)) return store;
+        std::cerr << "[!] " << path << " was written for another context, key, gallery or DB shape; ignoring it\n";
+    } catch (const std::exception &e) {
+        std::cerr << "[!] " << e.what() << "; ignoring it\n";
+    }
+    return nullptr;
+}
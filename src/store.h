@@ -0,0 +1,101 @@
+// store.h -- persistent encrypted DB store
+//
+// The encrypted DB (packed ciphertexts or diagonal ciphertexts, in the order the
+// similarity stage indexes them) is written once with OpenFHE binary serialization
+// and reopened on later runs instead of re-encrypting. File layout (host byte order):
+//
+//     magic "MRCLDB03"
+//     u32 layout, u32 level, u64 count, u64 dim, u64 slots, u64 regions, f64 scale,
+//     u64 crypto-context hash, u64 shard count, u32 key-tag length, key tag,
+//     u32 gallery length, gallery fingerprint
+//     shard table: (u64 offset, u64 size) per shard
+//     shard blobs: one serialized ciphertext each
+//
+// Opening a store mmaps the file and reads only the header and shard table, so
+// startup cost does not depend on the DB size. Each shard is deserialized on first
+// access (thread-safe, once per shard) straight from the mapping.
+//
+// Shards can only be deserialized once a context with the same parameters exists
+// (OpenFHE resolves the context of a ciphertext on load), and they only decrypt
+// under the key that wrote them: matches() checks both the context hash and the key tag.
+// It also checks the gallery fingerprint (VectorFile::fingerprint(), or a tag for the
+// generated DB): another file of the same shape, or the same file edited in place, must
+// not reuse ciphertexts of the old rows.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "openfhe/pke/openfhe.h"
+#include "scores.h"
+
+struct StoreHeader {
+    SimilarityLayout layout = SimilarityLayout::Packed;
+    uint32_t level = 0;     // level of the stored ciphertexts
+    uint64_t count = 0;     // DB vectors
+    uint64_t dim = 0;
+    uint64_t slots = 0;
+    uint64_t regions = 1;   // packed query-batch regions the DB is replicated over
+    double scale = 0;       // scaling factor of the stored ciphertexts
+    uint64_t cc_hash = 0;   // context_hash() of the writing context
+    std::string key_tag;    // tag of the public key the shards were encrypted under
+    std::string gallery;    // fingerprint of the source rows
+    uint64_t shards = 0;
+};
+
+// FNV-1a over the binary serialization of the context (parameters only, no keys).
+uint64_t context_hash(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc);
+
+// Writes `shards`, encrypted from the rows `gallery` identifies, to `path` (via a
+// temporary file renamed into place). Level, scale and key tag are taken from the first
+// shard. Throws std::runtime_error on I/O failure.
+void write_store(const std::string &path, const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                 const std::string &gallery, SimilarityLayout layout, size_t count, size_t dim, size_t slots,
+                 size_t regions, const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> &shards);
+
+class EncryptedStore {
+public:
+    // mmaps `path` and parses the header and shard table. Throws std::runtime_error
+    // if the file cannot be mapped or is not a well-formed store.
+    explicit EncryptedStore(const std::string &path);
+    ~EncryptedStore();
+    EncryptedStore(const EncryptedStore &) = delete;
+    EncryptedStore &operator=(const EncryptedStore &) = delete;
+
+    const StoreHeader &header() const { return header_; }
+    size_t size() const { return header_.shards; }
+
+    // True when the store was written for this context, key, gallery and DB shape.
+    bool matches(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                 const lbcrypto::PublicKey<lbcrypto::DCRTPoly> &pk, const std::string &gallery,
+                 SimilarityLayout layout, size_t count, size_t dim, size_t slots, size_t regions) const;
+
+    // Shard i, deserialized on first access. Safe to call from several threads.
+    lbcrypto::Ciphertext<lbcrypto::DCRTPoly> shard(size_t i) const;
+
+private:
+    struct Entry {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    const char *data_ = nullptr;
+    size_t length_ = 0;
+    StoreHeader header_;
+    std::vector<Entry> table_;
+    std::unique_ptr<std::once_flag[]> loaded_;
+    mutable std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> cache_;
+};
+
+// Opens `path` if it exists and matches(); otherwise returns null (a stale or
+// unreadable store is reported on std::cerr and ignored).
+std::unique_ptr<EncryptedStore> open_matching_store(const std::string &path,
+                                                    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly> &cc,
+                                                    const lbcrypto::PublicKey<lbcrypto::DCRTPoly> &pk,
+                                                    const std::string &gallery, SimilarityLayout layout,
+                                                    size_t count, size_t dim, size_t slots, size_t regions);
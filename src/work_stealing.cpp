@@ -0,0 +1,101 @@
+// work_stealing.cpp -- work-stealing thread pool (see work_stealing.h)
+
+#include "work_stealing.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < threads; i++) queues_.push_back(std::make_unique<Queue>());
+    for (size_t i = 0; i < threads; i++) workers_.emplace_back(&WorkStealingPool::worker_loop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto &t : workers_) t.join();
+}
+
+void WorkStealingPool::run(size_t n, const std::function<void(size_t, size_t)> &task) {
+    if (n == 0) return;
+    const size_t w = workers_.size();
+    // contiguous chunks keep neighbouring shards (same row block) on one worker
+    for (size_t i = 0; i < w; i++) {
+        std::lock_guard<std::mutex> lock(queues_[i]->mu);
+        for (size_t t = i * n / w; t < (i + 1) * n / w; t++) queues_[i]->tasks.push_back(t);
+    }
+    std::unique_lock<std::mutex> lock(mu_);
+    task_ = &task;
+    error_ = nullptr;
+    busy_ = w;
+    generation_++;
+    start_cv_.notify_all();
+    done_cv_.wait(lock, [&] { return busy_ == 0; });
+    task_ = nullptr;
+    if (error_) std::rethrow_exception(error_);
+}
+
+void WorkStealingPool::run_on(WorkStealingPool *pool, size_t n, const std::function<void(size_t, size_t)> &task) {
+    if (pool) {
+        pool->run(n, task);
+        return;
+    }
+    for (size_t t = 0; t < n; t++) task(t, 0);
+}
+
+bool WorkStealingPool::next_task(size_t id, size_t &task) {
+    {
+        Queue &own = *queues_[id];
+        std::lock_guard<std::mutex> lock(own.mu);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t k = 1; k < queues_.size(); k++) {
+        Queue &victim = *queues_[(id + k) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mu);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::worker_loop(size_t id) {
+#ifdef _OPENMP
+    omp_set_num_threads(1);  // OpenFHE's inner loops stay on this worker
+#endif
+    size_t seen = 0;
+    for (;;) {
+        const std::function<void(size_t, size_t)> *task;
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+            task = task_;
+        }
+        size_t t;
+        while (next_task(id, t)) {
+            try {
+                (*task)(t, id);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mu_);
+                if (!error_) error_ = std::current_exception();
+            }
+        }
+        std::lock_guard<std::mutex> lock(mu_);
+        if (--busy_ == 0) done_cv_.notify_one();
+    }
+}
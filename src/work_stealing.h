@@ -0,0 +1,63 @@
+// work_stealing.h -- small work-stealing thread pool for shard-level homomorphic work
+//
+// run(n, task) splits task indices [0, n) into contiguous per-worker deques. A worker
+// pops from the back of its own deque and, once empty, steals from the front of the
+// others, so uneven shards (e.g. a short last row block) do not leave cores idle.
+//
+// Each worker pins OpenMP to one thread: OpenFHE's internal parallel loops would
+// otherwise start a full team inside every worker and oversubscribe the machine.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+public:
+    // threads == 0: one worker per hardware thread.
+    explicit WorkStealingPool(size_t threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    // Runs task(index, worker) for every index in [0, n) and blocks until all are done.
+    // `worker` is in [0, size()) and identifies the calling worker, so tasks can keep
+    // per-worker partial results without locking. Rethrows the first task exception.
+    void run(size_t n, const std::function<void(size_t, size_t)> &task);
+
+    // run() on `pool`, or inline on the calling thread as worker 0 when pool is null.
+    static void run_on(WorkStealingPool *pool, size_t n, const std::function<void(size_t, size_t)> &task);
+    static size_t workers(const WorkStealingPool *pool) { return pool ? pool->size() : 1; }
+
+private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<size_t> tasks;
+    };
+
+    void worker_loop(size_t id);
+    bool next_task(size_t id, size_t &task);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+
+    std::mutex mu_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(size_t, size_t)> *task_ = nullptr;
+    size_t generation_ = 0;
+    size_t busy_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+};
@@ -0,0 +1,39 @@
+// check.h -- minimal assertions for the plaintext tests (no framework dependency)
+//
+// CHECK records a failure and keeps going, so one run reports every broken case;
+// main() returns finish(), which is nonzero if anything failed (what ctest looks at).
+
+#pragma once
+
+#include <cstdio>
+
+static int check_failures = 0;
+
+#define CHECK(cond)                                                                      \
+    do {                                                                                 \
+        if (!(cond)) {                                                                   \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            check_failures++;                                                            \
+        }                                                                                \
+    } while (0)
+
+// CHECK that `expr` throws an exception of type E.
+#define CHECK_THROWS(E, expr)                                                                    \
+    do {                                                                                         \
+        bool thrown = false;                                                                     \
+        try {                                                                                    \
+            (void)(expr);                                                                        \
+        } catch (const E &) {                                                                    \
+            thrown = true;                                                                       \
+        }                                                                                        \
+        if (!thrown) {                                                                           \
+            std::fprintf(stderr, "%s:%d: %s did not throw %s\n", __FILE__, __LINE__, #expr, #E); \
+            check_failures++;                                                                    \
+        }                                                                                        \
+    } while (0)
+
+static int finish(const char *name) {
+    if (check_failures) std::fprintf(stderr, "%s: %d check(s) failed\n", name, check_failures);
+    else std::printf("%s: all checks passed\n", name);
+    return check_failures ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+// test_kernels.cpp -- every SIMD level of normalize_rows / scan_similarities against naive loops
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "kernels.h"
+
+static const SimdLevel LEVELS[] = {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512};
+
+// Every level this CPU runs, lowest first.
+static std::vector<SimdLevel> supported_levels() {
+    std::vector<SimdLevel> out;
+    for (SimdLevel level : LEVELS)
+        if (level <= simd_level()) out.push_back(level);
+    return out;
+}
+
+static bool is_zero_row(size_t i) { return i % 5 == 2; }
+
+template <class T>
+static void fill(Matrix<T> &m, std::mt19937 &rng, bool zero_rows) {
+    std::normal_distribution<double> d;
+    for (size_t i = 0; i < m.rows(); i++)
+        for (size_t k = 0; k < m.cols(); k++) m(i, k) = zero_rows && is_zero_row(i) ? T(0) : static_cast<T>(d(rng));
+}
+
+template <class T>
+static void check_normalize(size_t n, size_t dim) {
+    const double tol = sizeof(T) == 4 ? 1e-6 : 1e-15;
+    for (SimdLevel level : supported_levels()) {
+        std::mt19937 rng(static_cast<unsigned>(n * 31 + dim));
+        Matrix<T> m(n, dim);
+        fill(m, rng, true);
+        std::vector<double> ref(n * dim);
+        size_t zero_ref = 0;
+        for (size_t i = 0; i < n; i++) {
+            double ss = 0;
+            for (size_t k = 0; k < dim; k++) ss += double(m(i, k)) * m(i, k);
+            if (ss == 0) zero_ref++;
+            for (size_t k = 0; k < dim; k++) ref[i * dim + k] = ss == 0 ? 0 : m(i, k) / std::sqrt(ss);
+        }
+
+        CHECK(normalize_rows(m, n, level) == zero_ref);
+        for (size_t i = 0; i < n; i++) {
+            for (size_t k = 0; k < dim; k++) CHECK(std::abs(m(i, k) - ref[i * dim + k]) <= tol);
+            for (size_t k = dim; k < m.ld(); k++) CHECK(m.row(i)[k] == 0);  // padding untouched
+        }
+    }
+}
+
+// Scores every row against every probe in two chunks and compares with a sequential scan.
+template <class T>
+static void check_scan(size_t n, size_t dim, size_t probes) {
+    const double tol = sizeof(T) == 4 ? 1e-4 : 1e-12;
+    std::mt19937 rng(static_cast<unsigned>(n * 7 + dim * 3 + probes));
+    Matrix<T> rows(n, dim), p(probes, dim);
+    fill(rows, rng, true);
+    fill(p, rng, false);
+    normalize_rows(rows, n, SimdLevel::Scalar);
+    normalize_rows(p, probes, SimdLevel::Scalar);
+
+    for (SimdLevel level : supported_levels()) {
+        std::vector<BestMatch> best(probes);
+        std::vector<double> sims(probes * n, 99);
+        const size_t half = n / 2;
+        scan_similarities(row_block(rows, 0, 0, half), p, best, sims.data(), n, level);
+        scan_similarities(row_block(rows, half, half, n - half), p, best, sims.data(), n, level);
+        for (size_t q = 0; q < probes; q++) {
+            double ref_best = -INFINITY;
+            size_t ref_index = 0;
+            for (size_t i = 0; i < n; i++) {
+                double s = 0;
+                for (size_t k = 0; k < dim; k++) s += double(rows(i, k)) * p(q, k);
+                CHECK(std::abs(s - sims[q * n + i]) <= tol);
+                if (s > ref_best) {
+                    ref_best = s;
+                    ref_index = i;
+                }
+            }
+            CHECK(std::abs(best[q].score - ref_best) <= tol);
+            // a different index is only acceptable for a near-tie within rounding
+            CHECK(best[q].index == ref_index || std::abs(sims[q * n + best[q].index] - ref_best) <= tol);
+        }
+    }
+}
+
+// Identical rows: the lowest gallery index must win at every level, inside a vector
+// block, in the scalar tail and across chunks. All-ones rows make the scores exact.
+static void check_ties() {
+    for (SimdLevel level : supported_levels()) {
+        for (size_t n : {1, 7, 50, 257}) {
+            Matrix<float> rows(n, 16), p(1, 16);
+            for (size_t i = 0; i < n; i++)
+                for (size_t k = 0; k < 16; k++) rows(i, k) = 1;
+            for (size_t k = 0; k < 16; k++) p(0, k) = 1;
+            std::vector<BestMatch> best(1);
+            const size_t third = n / 3;
+            scan_similarities(row_block(rows, 0, 0, third), p, best, nullptr, 0, level);
+            scan_similarities(row_block(rows, third, third, n - third), p, best, nullptr, 0, level);
+            CHECK(best[0].index == 0);
+            CHECK(best[0].score == 16);
+        }
+    }
+}
+
+static void check_errors() {
+    Matrix<double> rows(4, 8), probes(2, 8), other(2, 4);
+    std::vector<BestMatch> best(2);
+    CHECK_THROWS(std::invalid_argument, scan_similarities(row_block(rows, 0, 0, 4), other, best));
+    std::vector<BestMatch> wrong(3);
+    CHECK_THROWS(std::invalid_argument, scan_similarities(row_block(rows, 0, 0, 4), probes, wrong));
+    Matrix<double> col(4, 8, MatrixOrder::ColMajor);
+    CHECK_THROWS(std::invalid_argument, normalize_rows(col));
+    CHECK_THROWS(std::invalid_argument, normalize_rows(rows, 5));
+}
+
+int main() {
+    std::printf("simd level: %s\n", simd_level_name(simd_level()));
+    for (size_t dim : {1, 5, 13, 16, 64, 100, 512})
+        for (size_t n : {0, 1, 7, 17, 100, 1000}) {
+            check_normalize<float>(n, dim);
+            check_normalize<double>(n, dim);
+        }
+    for (size_t dim : {1, 5, 16, 64, 100, 512})
+        for (size_t n : {1, 3, 17, 33, 257, 1000})
+            for (size_t probes : {1, 3, 4, 9}) {
+                check_scan<float>(n, dim, probes);
+                check_scan<double>(n, dim, probes);
+            }
+    check_ties();
+    check_errors();
+    return finish("test_kernels");
+}
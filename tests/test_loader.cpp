@@ -0,0 +1,159 @@
+// test_loader.cpp -- VectorFile on generated .fvecs / .npy / raw files, good and malformed
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "check.h"
+#include "loader.h"
+
+static const size_t ROWS = 1000;
+static const size_t DIM = 16;
+static const size_t ZERO_ROW = 123;  // all-zero row planted in every file
+
+static std::filesystem::path dir;
+
+static std::string path_of(const std::string &name) { return (dir / name).string(); }
+
+static void write_bytes(const std::string &name, const std::string &bytes) {
+    std::ofstream os(path_of(name), std::ios::binary | std::ios::trunc);
+    os.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+template <class T>
+static void append(std::string &out, const T &v) {
+    out.append(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+static std::string fvecs(const std::vector<float> &values, size_t rows) {
+    std::string out;
+    for (size_t i = 0; i < rows; i++) {
+        append<int32_t>(out, static_cast<int32_t>(DIM));
+        for (size_t k = 0; k < DIM; k++) append(out, values[i * DIM + k]);
+    }
+    return out;
+}
+
+// .npy with the given format version, dtype and order; `rows` goes into the shape,
+// `data_rows` rows are actually written.
+template <class T>
+static std::string npy(const std::vector<float> &values, int major, const std::string &descr, bool fortran,
+                       size_t rows, size_t data_rows) {
+    std::string header = "{'descr': '" + descr + "', 'fortran_order': " + (fortran ? "True" : "False") +
+                         ", 'shape': (" + std::to_string(rows) + ", " + std::to_string(DIM) + "), }";
+    const size_t prefix = major == 1 ? 10 : 12;
+    while ((prefix + header.size() + 1) % 64 != 0) header += ' ';
+    header += '\n';
+    std::string out("\x93NUMPY", 6);
+    out += static_cast<char>(major);
+    out += '\0';
+    if (major == 1) append<uint16_t>(out, static_cast<uint16_t>(header.size()));
+    else append<uint32_t>(out, static_cast<uint32_t>(header.size()));
+    out += header;
+    for (size_t i = 0; i < data_rows * DIM; i++) append<T>(out, static_cast<T>(values[i]));
+    return out;
+}
+
+// Reads `name` in chunks into float and double matrices and compares with the
+// normalized reference.
+static void check_reads(const std::string &name, const std::vector<float> &values, size_t raw_dim = 0) {
+    VectorFile f(path_of(name), raw_dim);
+    CHECK(f.count() == ROWS);
+    CHECK(f.dim() == DIM);
+    const size_t chunk = 300;
+    Matrix<double> md(chunk, DIM);
+    Matrix<float> mf(chunk, DIM);
+    size_t zero_d = 0, zero_f = 0;
+    for (size_t first = 0; first < ROWS; first += chunk) {
+        const size_t n = std::min(chunk, ROWS - first);
+        zero_d += f.read_normalized(first, n, md);
+        zero_f += f.read_normalized(first, n, mf);
+        for (size_t r = 0; r < n; r++) {
+            const float *v = &values[(first + r) * DIM];
+            double ss = 0;
+            for (size_t k = 0; k < DIM; k++) ss += double(v[k]) * v[k];
+            for (size_t k = 0; k < DIM; k++) {
+                const double ref = ss == 0 ? 0 : v[k] / std::sqrt(ss);
+                CHECK(std::abs(md(r, k) - ref) <= 1e-12);
+                CHECK(std::abs(mf(r, k) - ref) <= 1e-6);
+            }
+        }
+    }
+    CHECK(zero_d == 1);
+    CHECK(zero_f == 1);
+    CHECK_THROWS(std::out_of_range, f.read_normalized(ROWS - 1, 2, md));
+    Matrix<double> narrow(chunk, DIM / 2);
+    CHECK_THROWS(std::invalid_argument, f.read_normalized(0, 1, narrow));
+}
+
+int main() {
+    dir = std::filesystem::temp_directory_path() / ("mercle_loader_test_" + std::to_string(::getpid()));
+    std::filesystem::create_directories(dir);
+
+    std::mt19937 rng(7);
+    std::normal_distribution<float> d;
+    std::vector<float> values(ROWS * DIM);
+    for (float &v : values) v = d(rng);
+    std::fill(values.begin() + ZERO_ROW * DIM, values.begin() + (ZERO_ROW + 1) * DIM, 0.0f);
+
+    // well-formed files
+    write_bytes("g.fvecs", fvecs(values, ROWS));
+    write_bytes("g1.npy", npy<float>(values, 1, "<f4", false, ROWS, ROWS));
+    write_bytes("g2.npy", npy<double>(values, 2, "<f8", false, ROWS, ROWS));
+    std::string raw;
+    for (float v : values) append(raw, v);
+    write_bytes("g.f32", raw);
+    check_reads("g.fvecs", values);
+    check_reads("g1.npy", values);
+    check_reads("g2.npy", values);
+    check_reads("g.f32", values, DIM);
+    CHECK(vector_format_for("x.fvecs") == VectorFormat::Fvecs);
+    CHECK(vector_format_for("x.npy") == VectorFormat::Npy);
+    CHECK(vector_format_for("x.bin") == VectorFormat::RawF32);
+
+    // malformed files are rejected up front
+    write_bytes("fortran.npy", npy<float>(values, 1, "<f4", true, ROWS, ROWS));
+    CHECK_THROWS(std::runtime_error, VectorFile(path_of("fortran.npy")));
+    write_bytes("big_endian.npy", npy<float>(values, 1, ">f4", false, ROWS, ROWS));
+    CHECK_THROWS(std::runtime_error, VectorFile(path_of("big_endian.npy")));
+    write_bytes("short.npy", npy<float>(values, 1, "<f4", false, ROWS, ROWS - 1));
+    CHECK_THROWS(std::runtime_error, VectorFile(path_of("short.npy")));
+    write_bytes("truncated.fvecs", fvecs(values, ROWS).substr(0, ROWS * (4 + 4 * DIM) - 3));
+    CHECK_THROWS(std::runtime_error, VectorFile(path_of("truncated.fvecs")));
+    write_bytes("truncated.f32", raw.substr(0, raw.size() - 4));
+    CHECK_THROWS(std::runtime_error, VectorFile(path_of("truncated.f32"), DIM));
+    write_bytes("empty.fvecs", "");
+    CHECK_THROWS(std::runtime_error, VectorFile(path_of("empty.fvecs")));
+    CHECK_THROWS(std::invalid_argument, VectorFile(path_of("g.f32")));  // raw needs a dimension
+    CHECK_THROWS(std::runtime_error, VectorFile(path_of("missing.fvecs")));
+
+    // a ragged .fvecs row (dimension prefix 15 in a file of 16-D rows) fails when read
+    std::string ragged = fvecs(values, ROWS);
+    const int32_t bad_dim = static_cast<int32_t>(DIM - 1);
+    std::memcpy(&ragged[500 * (4 + 4 * DIM)], &bad_dim, sizeof(bad_dim));
+    write_bytes("ragged.fvecs", ragged);
+    {
+        VectorFile f(path_of("ragged.fvecs"));
+        Matrix<double> m(ROWS, DIM);
+        CHECK(f.read_normalized(0, 500, m) == 1);
+        CHECK_THROWS(std::runtime_error, f.read_normalized(400, 200, m));
+    }
+
+    // the fingerprint follows the file, not just its shape
+    {
+        const std::string before = VectorFile(path_of("g.fvecs")).fingerprint();
+        CHECK(before == VectorFile(path_of("g.fvecs")).fingerprint());
+        CHECK(before != VectorFile(path_of("ragged.fvecs")).fingerprint());
+    }
+
+    std::filesystem::remove_all(dir);
+    return finish("test_loader");
+}
@@ -0,0 +1,58 @@
+// test_work_stealing.cpp -- WorkStealingPool: every index exactly once, reuse, errors
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "check.h"
+#include "work_stealing.h"
+
+// Runs n tasks and checks each index ran once, on a valid worker.
+static void check_run(WorkStealingPool *pool, size_t n) {
+    std::unique_ptr<std::atomic<int>[]> hits(new std::atomic<int>[n]());
+    std::atomic<bool> bad_worker{false};
+    WorkStealingPool::run_on(pool, n, [&](size_t i, size_t worker) {
+        hits[i]++;
+        if (worker >= WorkStealingPool::workers(pool)) bad_worker = true;
+    });
+    for (size_t i = 0; i < n; i++) CHECK(hits[i] == 1);
+    CHECK(!bad_worker);
+}
+
+int main() {
+    WorkStealingPool pool(4);
+    CHECK(pool.size() == 4);
+
+    // one pool, many runs of every size, including fewer tasks than workers
+    for (size_t it = 0; it < 500; it++) check_run(&pool, it % 37);
+    check_run(&pool, 10000);
+
+    // uneven tasks: the long ones sit in one worker's chunk, the others steal the rest
+    std::atomic<size_t> done{0};
+    pool.run(64, [&](size_t i, size_t) {
+        volatile double x = 0;
+        for (size_t k = 0; k < (i < 16 ? 200000u : 100u); k++) x = x + 1;
+        done++;
+    });
+    CHECK(done == 64);
+
+    // the first exception is rethrown after all tasks finished, and the pool stays usable
+    std::atomic<size_t> ran{0};
+    CHECK_THROWS(std::runtime_error, pool.run(100, [&](size_t i, size_t) {
+        ran++;
+        if (i % 10 == 3) throw std::runtime_error("task failed");
+    }));
+    CHECK(ran == 100);
+    check_run(&pool, 100);
+
+    // null pool: inline on the calling thread as worker 0
+    CHECK(WorkStealingPool::workers(nullptr) == 1);
+    check_run(nullptr, 50);
+
+    WorkStealingPool automatic;
+    CHECK(automatic.size() >= 1);
+    check_run(&automatic, 1000);
+
+    return finish("test_work_stealing");
+}